@@ -0,0 +1,88 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "background_job.h"
+
+#include <exception>
+
+#include "h_time.h"
+
+std::atomic<int> BackgroundJob::active{0};
+
+BackgroundJob::~BackgroundJob() {
+    cancel();
+    wait();
+}
+
+/**
+ * Starts some work on a new thread, unless the job is still busy with the previous one.
+ * @param steps The number of steps the work will report (see JobProgress::step()).
+ * @param work The work, which should check JobProgress::checkCancelled() from time to time; anything it throws ends up in
+ * getError(), except JobCancelled.
+ * @return Whether the work has been started.
+ */
+bool BackgroundJob::start(size_t steps, const std::function<void(JobProgress&)>& work) {
+    if (isBusy()) return false;
+    progress.steps_done = 0;
+    progress.steps_total = steps;
+    progress.cancelled = false;
+    error.clear();
+    cancelled = false;
+    elapsed_ns = 0;
+    running = true;
+    active++;
+    worker = std::thread([this, work]() {
+	timespec_t ts;
+	nsec_t start = HTime_GetNsDelta(&ts);
+	try {
+	    work(progress);
+	} catch (JobCancelled&) {
+	    cancelled = true;
+	} catch (std::exception& e) {
+	    error = e.what();
+	}
+	cancelled = cancelled || progress.cancelled;
+	elapsed_ns = static_cast<long double>(HTime_GetNsDelta(&ts) - start);
+	active--;
+	running = false;
+    });
+    return true;
+}
+
+/**
+ * To be called every frame by the owner of the job.
+ * @return True once, on the first call after the work has ended (whether it succeeded, failed or has been cancelled);
+ * the results of the work can then be collected without locking.
+ */
+bool BackgroundJob::poll() {
+    if (!isBusy() || running) return false;
+    worker.join();
+    return true;
+}
+
+/**
+ * Blocks until the work has ended, then collects it like poll() does.
+ */
+void BackgroundJob::wait() {
+    if (isBusy()) worker.join();
+}
@@ -0,0 +1,100 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_BACKGROUND_JOB_H
+#define PROJ2_BACKGROUND_JOB_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/**
+ * Thrown by the work of a job when it notices that it has been cancelled.
+ */
+class JobCancelled : public std::runtime_error {
+   public:
+    JobCancelled() : std::runtime_error("Cancelled.") {}
+};
+
+/**
+ * How far a job has got, and whether it should stop. Updated by the thread(s) doing the work, read by the UI.
+ */
+struct JobProgress {
+    std::atomic<size_t> steps_done{0};
+    std::atomic<size_t> steps_total{0};
+    std::atomic<bool> cancelled{false};
+
+    void step(size_t steps = 1) { steps_done += steps; }
+    void checkCancelled() const {
+	if (cancelled) throw JobCancelled();
+    }
+    float getFraction() const {
+	size_t total = steps_total;
+	return total == 0 ? 0.0f : static_cast<float>(steps_done) / static_cast<float>(total);
+    }
+};
+
+/**
+ * Runs some work on a thread of its own, so that the render loop can keep drawing frames while it's in progress. The
+ * window that owns the job starts it, then polls it every frame: the work reports its progress through a JobProgress and
+ * publishes its results under lockResults(), so that they can be shown as they come (and kept if the job is cancelled).
+ * A job runs one piece of work at a time; destroying it cancels the work and waits for it.
+ */
+class BackgroundJob {
+   private:
+    std::thread worker;
+    std::atomic<bool> running{false};
+    JobProgress progress;
+    std::mutex results_mtx;
+    std::string error;  // Written by the worker before running is cleared
+    bool cancelled = false;
+    long double elapsed_ns = 0;
+
+    static std::atomic<int> active;
+
+   public:
+    BackgroundJob() = default;
+    ~BackgroundJob();
+    BackgroundJob(const BackgroundJob&) = delete;
+    BackgroundJob& operator=(const BackgroundJob&) = delete;
+
+    bool start(size_t steps, const std::function<void(JobProgress&)>& work);
+    bool poll();
+    void cancel() { progress.cancelled = true; }
+    void wait();
+
+    bool isBusy() const { return worker.joinable(); }
+    const JobProgress& getProgress() const { return progress; }
+    std::unique_lock<std::mutex> lockResults() { return std::unique_lock<std::mutex>(results_mtx); }
+    const std::string& getError() const { return error; }
+    bool wasCancelled() const { return cancelled; }
+    long double getElapsedNs() const { return elapsed_ns; }
+
+    static int getActiveCount() { return active; }
+};
+
+#endif  // PROJ2_BACKGROUND_JOB_H
@@ -0,0 +1,158 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "bench_harness.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+BenchPin::BenchPin(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return;
+    cpu_set_t old_set, new_set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set) != 0) return;
+    CPU_ZERO(&new_set);
+    CPU_SET(cpu, &new_set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(new_set), &new_set) != 0) return;
+    saved.assign(reinterpret_cast<unsigned char*>(&old_set), reinterpret_cast<unsigned char*>(&old_set) + sizeof(old_set));
+    pinned = true;
+#else
+    (void)cpu;
+#endif
+}
+
+BenchPin::~BenchPin() {
+#ifdef __linux__
+    if (pinned) pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), reinterpret_cast<cpu_set_t*>(&saved.front()));
+#endif
+}
+
+/**
+ * Computes the statistics of a set of samples. The percentiles are nearest-rank ones, so with few samples the p99 is
+ * simply the slowest one.
+ * @param samples The time per call of each sample, in nanoseconds; sorted in place.
+ * @param batch The number of calls per sample.
+ */
+BenchStats benchSummarize(std::vector<double>& samples, long batch) {
+    if (samples.empty()) throw std::invalid_argument("No samples to summarize.");
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    auto rank = [&](double p) { return samples[std::min(n - 1, static_cast<size_t>(std::ceil(p * n)) - 1)]; };
+    BenchStats stats;
+    stats.min = samples.front();
+    stats.median = n % 2 != 0 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    stats.p95 = rank(.95);
+    stats.p99 = rank(.99);
+    double sum = 0, sq_sum = 0;
+    for (double s : samples) sum += s;
+    stats.mean = sum / n;
+    for (double s : samples) sq_sum += (s - stats.mean) * (s - stats.mean);
+    stats.stddev = n > 1 ? std::sqrt(sq_sum / (n - 1)) : 0;
+    stats.samples = static_cast<int>(n);
+    stats.batch = batch;
+    return stats;
+}
+
+/**
+ * Measures a function: runs it config.warmup times without keeping the results, then takes config.repetitions samples.
+ * If a call is faster than config.min_sample_ns, each sample is made of as many calls as it takes to reach it (estimated
+ * from the fastest warm-up call), so that the timer's resolution and overhead don't dominate.
+ * @param call The function, which returns the time it took in nanoseconds (so that it can leave its setup out).
+ * @param config How to measure it. The pinning is up to the caller (see BenchPin), since it's usually shared by several
+ * measurements.
+ * @param progress If not nullptr, checked for cancellation between the samples.
+ * @return The statistics of the time per call. If config.counters is set, the hardware counters of the calling thread are
+ * read over all the samples (setup and checks included, warm-up excluded), then divided by the number of calls.
+ */
+BenchStats benchMeasure(const std::function<long double()>& call, const BenchConfig& config, JobProgress* progress) {
+    long double fastest = -1;
+    for (int i = 0; i < std::max(config.warmup, 1); i++) {  // At least one call is needed to size the batches
+	if (progress != nullptr) progress->checkCancelled();
+	long double elapsed = call();
+	if (fastest < 0 || elapsed < fastest) fastest = elapsed;
+    }
+    long batch = 1;
+    if (fastest < config.min_sample_ns)
+	batch = static_cast<long>(std::min<long double>(std::ceil(config.min_sample_ns / std::max(fastest, 1.0L)), BENCH_MAX_BATCH));
+    std::vector<double> samples;
+    samples.reserve(std::max(config.repetitions, 1));
+    std::unique_ptr<PerfCounters> counters;
+    if (config.counters) {
+	counters.reset(new PerfCounters(PERF_SCOPE_THREAD));
+	counters->start();
+    }
+    for (int i = 0; i < std::max(config.repetitions, 1); i++) {
+	if (progress != nullptr) progress->checkCancelled();
+	long double total = 0;
+	for (long j = 0; j < batch; j++) total += call();
+	samples.push_back(static_cast<double>(total / batch));
+    }
+    PerfCounts perf;
+    if (counters) perf = counters->stop().per(static_cast<double>(samples.size()) * batch);
+    BenchStats stats = benchSummarize(samples, batch);
+    stats.perf = perf;
+    return stats;
+}
+
+/**
+ * Writes the results of a benchmark to a CSV file with a header, one line per implementation and size, with all the
+ * statistics (in milliseconds) and the hardware counters per call (left empty where they haven't been read).
+ * @param path The file to write.
+ * @param names The names of the implementations.
+ * @param rows The heights of the matrices.
+ * @param cols The widths of the matrices, one for each height.
+ * @param stats The results, implementation by implementation: the same number for each of them, which is the number of
+ * sizes unless the benchmark has been cancelled.
+ * @throws std::runtime_error If the file can't be written.
+ */
+void benchExportCsv(const std::string& path, const std::vector<std::string>& names, const std::vector<int>& rows,
+		    const std::vector<int>& cols, const std::vector<BenchStats>& stats) {
+    if (stats.size() > names.size() * rows.size())
+	throw std::runtime_error("There are more results than implementations and sizes.");
+    std::ofstream file_ascii(path, std::ofstream::out);
+    if (!file_ascii) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    file_ascii << "implementation,rows,cols,samples,batch,min_ms,median_ms,p95_ms,p99_ms,mean_ms,stddev_ms,ipc,cycles,instructions,"
+		  "l1d_misses,llc_misses,branch_misses" << std::endl;
+    size_t per_impl = names.empty() ? 0 : stats.size() / names.size();
+    for (size_t i = 0; i < names.size(); i++) {
+	for (size_t s = 0; s < per_impl; s++) {
+	    const BenchStats& st = stats[i * per_impl + s];
+	    file_ascii << names[i] << ',' << rows[s] << ',' << cols[s] << ',' << st.samples << ',' << st.batch << ',' << st.min / 1e6 << ','
+		       << st.median / 1e6 << ',' << st.p95 / 1e6 << ',' << st.p99 / 1e6 << ',' << st.mean / 1e6 << ','
+		       << st.stddev / 1e6 << ',';
+	    if (st.perf.getIpc() > 0) file_ascii << st.perf.getIpc();
+	    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		file_ascii << ',';
+		if (st.perf.isValid(c)) file_ascii << st.perf.values[c];
+	    }
+	    file_ascii << std::endl;
+	}
+    }
+    if (!file_ascii) throw std::runtime_error("An I/O error occurred while writing the file.");
+}
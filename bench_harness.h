@@ -0,0 +1,83 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_BENCH_HARNESS_H
+#define PROJ2_BENCH_HARNESS_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "background_job.h"
+#include "perf_counters.h"
+
+#define BENCH_DEFAULT_WARMUP 3
+#define BENCH_DEFAULT_REPETITIONS 25
+#define BENCH_DEFAULT_MIN_SAMPLE_NS 200000.0L  // Calls faster than this are repeated within each sample
+#define BENCH_MAX_BATCH 100000
+
+/**
+ * How a measurement is taken.
+ */
+struct BenchConfig {
+    int warmup = BENCH_DEFAULT_WARMUP;            // Untimed calls, to fill the caches and the basis tables
+    int repetitions = BENCH_DEFAULT_REPETITIONS;  // Samples
+    long double min_sample_ns = BENCH_DEFAULT_MIN_SAMPLE_NS;
+    int cpu = -1;  // The core the measuring thread is pinned to, or -1
+    bool counters = false;  // Whether to read the hardware counters (see PerfCounters) during the samples
+};
+
+/**
+ * The distribution of the time per call, in nanoseconds.
+ */
+struct BenchStats {
+    double min, median, p95, p99, mean, stddev;
+    int samples;
+    long batch;  // Calls per sample
+    PerfCounts perf;  // Per call, if BenchConfig::counters was set and the counters are available
+};
+
+/**
+ * Pins the calling thread to a core for as long as it exists, then restores the previous affinity. Does nothing (and
+ * isPinned() returns false) if the core doesn't exist or the platform doesn't support it.
+ */
+class BenchPin {
+   private:
+    bool pinned = false;
+    std::vector<unsigned char> saved;  // The previous affinity mask
+
+   public:
+    explicit BenchPin(int cpu);
+    ~BenchPin();
+    BenchPin(const BenchPin&) = delete;
+    BenchPin& operator=(const BenchPin&) = delete;
+
+    bool isPinned() const { return pinned; }
+};
+
+BenchStats benchSummarize(std::vector<double>&, long);
+BenchStats benchMeasure(const std::function<long double()>&, const BenchConfig&, JobProgress* = nullptr);
+void benchExportCsv(const std::string&, const std::vector<std::string>&, const std::vector<int>&, const std::vector<int>&,
+		    const std::vector<BenchStats>&);
+
+#endif  // PROJ2_BENCH_HARNESS_H
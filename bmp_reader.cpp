@@ -0,0 +1,185 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "bmp_reader.h"
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <stdexcept>
+
+static inline unsigned bmpU16(const unsigned char* p) { return p[0] | p[1] << 8; }
+static inline unsigned long bmpU32(const unsigned char* p) {
+    return bmpU16(p) | static_cast<unsigned long>(bmpU16(p + 2)) << 16;
+}
+
+/**
+ * Same as stbi__compute_y().
+ */
+static inline unsigned char bmpGray(unsigned r, unsigned g, unsigned b) {
+    return static_cast<unsigned char>((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+/**
+ * Parses the headers of a BMP file.
+ * @param header The first BMP_READER_HEADER_SIZE bytes of the file.
+ * @throws std::runtime_error If the file is not an uncompressed 8, 24 or 32-bit BMP.
+ */
+static BmpLayout bmpParseLayout(const unsigned char* header) {
+    if (header[0] != 'B' || header[1] != 'M') throw std::runtime_error("Not a BMP file.");
+    BmpLayout layout{};
+    layout.data_offset = static_cast<long long>(bmpU32(header + 10));
+    unsigned long info_size = bmpU32(header + 14);
+    long w = static_cast<long>(static_cast<int32_t>(bmpU32(header + 18)));
+    long h = static_cast<long>(static_cast<int32_t>(bmpU32(header + 22)));
+    layout.bits_per_pixel = static_cast<int>(bmpU16(header + 28));
+    unsigned long compression = bmpU32(header + 30);
+    if (info_size < 40) throw std::runtime_error("Unsupported BMP header.");
+    if (compression != 0) throw std::runtime_error("Compressed BMP images are not supported.");
+    if (layout.bits_per_pixel != 8 && layout.bits_per_pixel != 24 && layout.bits_per_pixel != 32)
+	throw std::runtime_error("Unsupported BMP pixel format.");
+    layout.bottom_up = h > 0;
+    if (h < 0) h = -h;
+    if (w <= 0 || h <= 0 || w > BMP_READER_MAX_DIM || h > BMP_READER_MAX_DIM)
+	throw std::runtime_error("Invalid BMP image size.");
+    layout.width = static_cast<int>(w);
+    layout.height = static_cast<int>(h);
+    layout.row_size = (static_cast<size_t>(layout.width) * layout.bits_per_pixel / 8 + 3) & ~static_cast<size_t>(3);
+    layout.palette_offset = 14 + static_cast<long long>(info_size);
+    layout.colors = bmpU32(header + 46);
+    if (layout.colors == 0 || layout.colors > 256) layout.colors = 256;
+    return layout;
+}
+
+/**
+ * Converts the palette entries (4 bytes each) to gray levels. Missing entries are black.
+ */
+static void bmpGrayPalette(const unsigned char* entries, unsigned long colors, unsigned char* palette) {
+    for (unsigned i = 0; i < 256; i++)
+	palette[i] = i < colors ? bmpGray(entries[i * 4 + 2], entries[i * 4 + 1], entries[i * 4]) : 0;
+}
+
+static void bmpConvertRow(const BmpLayout& layout, const unsigned char* palette, const unsigned char* src,
+			  unsigned char* out) {
+    int width = layout.width;
+    switch (layout.bits_per_pixel) {
+	case 8:
+	    for (int x = 0; x < width; x++) out[x] = palette[src[x]];
+	    break;
+	case 24:
+	    for (int x = 0; x < width; x++, src += 3) out[x] = bmpGray(src[2], src[1], src[0]);
+	    break;
+	default:
+	    for (int x = 0; x < width; x++, src += 4) out[x] = bmpGray(src[2], src[1], src[0]);
+    }
+}
+
+/**
+ * Opens a BMP file and reads its headers.
+ * @param path The path of the file.
+ * @throws std::runtime_error If the file can't be read or is not an uncompressed 8, 24 or 32-bit BMP.
+ */
+BmpReader::BmpReader(const std::string& path) : file(nullptr), layout() {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) throw std::runtime_error("Unable to open the specified image file.");
+    try {
+	unsigned char header[BMP_READER_HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), file) != sizeof(header)) throw std::runtime_error("Not a BMP file.");
+	layout = bmpParseLayout(header);
+	if (layout.bits_per_pixel == 8) {
+	    unsigned char entries[256 * 4];
+	    if (fseeko(file, static_cast<off_t>(layout.palette_offset), SEEK_SET) != 0 ||
+		fread(entries, 4, layout.colors, file) != layout.colors)
+		throw std::runtime_error("Truncated BMP palette.");
+	    bmpGrayPalette(entries, layout.colors, palette);
+	}
+    } catch (...) {
+	fclose(file);
+	throw;
+    }
+}
+
+BmpReader::~BmpReader() { fclose(file); }
+
+/**
+ * Reads some consecutive rows of the image.
+ * @param first The first row to read, counting from the top.
+ * @param count The number of rows to read.
+ * @param dst Where the first pixel of the first row goes.
+ * @param stride The distance between two consecutive rows in dst.
+ * @throws std::runtime_error If the rows are out of the image or the file is truncated.
+ */
+void BmpReader::readRows(int first, int count, unsigned char* dst, ptrdiff_t stride) {
+    if (first < 0 || count < 0 || count > layout.height - first) throw std::out_of_range("Rows out of the image.");
+    if (count == 0) return;
+    // The rows are contiguous in the file either way: only the order changes
+    int stored_first = layout.bottom_up ? layout.height - first - count : first;
+    size_t row_size = layout.row_size;
+    raw.resize(row_size * count);
+    off_t offset = static_cast<off_t>(layout.data_offset + static_cast<long long>(stored_first) * row_size);
+    if (fseeko(file, offset, SEEK_SET) != 0 || fread(&raw.front(), row_size, count, file) != static_cast<size_t>(count))
+	throw std::runtime_error("Truncated BMP image.");
+    for (int row = 0; row < count; row++) {
+	const unsigned char* src = &raw[row_size * (layout.bottom_up ? count - 1 - row : row)];
+	bmpConvertRow(layout, palette, src, dst + static_cast<ptrdiff_t>(row) * stride);
+    }
+}
+
+/**
+ * Maps a BMP file and exposes its pixels (see BmpMapping).
+ * @param path The path of the file.
+ * @throws std::runtime_error If the file can't be mapped, is truncated or is not an uncompressed 8, 24 or 32-bit BMP.
+ */
+BmpMapping::BmpMapping(const std::string& path) : file(path), layout(), origin(nullptr), stride(0) {
+    if (file.getLength() < BMP_READER_HEADER_SIZE) throw std::runtime_error("Not a BMP file.");
+    const unsigned char* bytes = file.getBytes();
+    layout = bmpParseLayout(bytes);
+    unsigned long long end = static_cast<unsigned long long>(layout.data_offset) +
+			     static_cast<unsigned long long>(layout.row_size) * static_cast<unsigned>(layout.height);
+    unsigned long long palette_end = static_cast<unsigned long long>(layout.palette_offset) + 4ULL * layout.colors;
+    if (end > file.getLength() || (layout.bits_per_pixel == 8 && palette_end > file.getLength()))
+	throw std::runtime_error("Truncated BMP image.");
+    unsigned char palette[256];
+    bool gray = false;
+    if (layout.bits_per_pixel == 8) {
+	bmpGrayPalette(bytes + layout.palette_offset, layout.colors, palette);
+	gray = true;
+	for (unsigned i = 0; i < 256 && gray; i++) gray = palette[i] == i;
+    }
+    const unsigned char* first_row =
+	bytes + layout.data_offset + (layout.bottom_up ? (layout.height - 1) * layout.row_size : 0);
+    ptrdiff_t row_step = layout.bottom_up ? -static_cast<ptrdiff_t>(layout.row_size) : layout.row_size;
+    if (gray) {
+	file.adviseWillNeed();
+	origin = first_row;
+	stride = row_step;
+	return;
+    }
+    file.adviseSequential();
+    decoded.resize(static_cast<size_t>(layout.width) * layout.height);
+    for (int y = 0; y < layout.height; y++)
+	bmpConvertRow(layout, palette, first_row + y * row_step, &decoded[static_cast<size_t>(y) * layout.width]);
+    file.unmap();
+    origin = &decoded.front();
+    stride = layout.width;
+}
@@ -0,0 +1,96 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_BMP_READER_H
+#define PROJ2_BMP_READER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "file_mapping.h"
+
+#define BMP_READER_MAX_DIM 0x7FFFFFFF
+#define BMP_READER_HEADER_SIZE 54  // File header and BITMAPINFOHEADER
+
+/**
+ * Where and how the pixels of a BMP file are stored.
+ */
+struct BmpLayout {
+    int width, height;
+    int bits_per_pixel;       // 8 (paletted), 24 or 32
+    bool bottom_up;           // Rows are stored from the last one to the first one
+    long long data_offset;    // Where the first stored row begins
+    size_t row_size;          // Bytes per stored row, padding included
+    long long palette_offset;
+    unsigned long colors;     // Palette entries
+};
+
+/**
+ * Reads the rows of an uncompressed BMP image (8-bit paletted, 24-bit or 32-bit) as 8-bit grayscale, a few at a time, so
+ * that the whole image never needs to be in memory. The conversion to grayscale is the one done by stbi_load(), so the
+ * pixels are the same Image::load() would get.
+ */
+class BmpReader {
+   private:
+    FILE* file;
+    BmpLayout layout;
+    unsigned char palette[256];      // Gray level of each palette entry
+    std::vector<unsigned char> raw;  // The stored rows being converted
+
+   public:
+    explicit BmpReader(const std::string& path);
+    ~BmpReader();
+    BmpReader(const BmpReader&) = delete;
+    BmpReader& operator=(const BmpReader&) = delete;
+
+    int getWidth() const { return layout.width; }
+    int getHeight() const { return layout.height; }
+    void readRows(int first, int count, unsigned char* dst, ptrdiff_t stride);
+};
+
+/**
+ * A whole BMP image seen as 8-bit grayscale through a FileMapping. Grayscale-paletted 8-bit pixels (the usual format of
+ * grayscale BMPs) are exposed in place, with a negative stride if the rows are stored bottom-up; any other uncompressed
+ * layout is converted once into a buffer owned by the object.
+ */
+class BmpMapping {
+   private:
+    FileMapping file;
+    BmpLayout layout;
+    const unsigned char* origin;  // The top-left pixel
+    ptrdiff_t stride;
+    std::vector<unsigned char> decoded;  // The pixels, if they can't be seen in place
+
+   public:
+    explicit BmpMapping(const std::string& path);
+
+    int getWidth() const { return layout.width; }
+    int getHeight() const { return layout.height; }
+    const unsigned char* getOrigin() const { return origin; }
+    ptrdiff_t getStride() const { return stride; }
+    bool isDirect() const { return decoded.empty(); }
+};
+
+#endif  // PROJ2_BMP_READER_H
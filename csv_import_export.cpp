@@ -23,11 +23,297 @@
 
 #include "csv_import_export.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
+#include "file_mapping.h"
+#include "thread_pool.h"
+
+static const double csv_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+				   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};  // All exact
+
+/**
+ * Parses a number like strtod() does, for the cells that CSV files usually hold (plain decimals, with up to 19 significant
+ * digits and an optional exponent): when the digits fit in 53 bits and the power of ten is exact, a single multiplication
+ * or division gives the correctly rounded result. Anything else is copied and left to strtod().
+ * @param str The number, with no leading whitespace.
+ * @param limit The end of the cell (the text isn't NUL-terminated).
+ * @param end Set to the first character after the number, or to str if there's none.
+ * @return The number; errno is set to ERANGE if it's out of range.
+ */
+static double csvParseDouble(const char* str, const char* limit, const char** end) {
+    auto at = [limit](const char* p) { return p < limit ? *p : '\0'; };
+    auto fallback = [str, limit, end]() {
+	std::string cell(str, limit);
+	char* cell_end;
+	double value = strtod(cell.c_str(), &cell_end);
+	*end = str + (cell_end - cell.c_str());
+	return value;
+    };
+    const char* pos = str;
+    bool negative = at(pos) == '-';
+    if (at(pos) == '-' || at(pos) == '+') pos++;
+    if (at(pos) == '0' && (at(pos + 1) == 'x' || at(pos + 1) == 'X')) return fallback();  // Hexadecimal
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; at(pos) >= '0' && at(pos) <= '9'; pos++, any = true) {
+	if (digits == 0 && *pos == '0') continue;  // Leading zeros don't count
+	if (++digits > 19) return fallback();
+	mantissa = mantissa * 10 + (*pos - '0');
+    }
+    if (at(pos) == '.') {
+	for (pos++; at(pos) >= '0' && at(pos) <= '9'; pos++, any = true) {
+	    if (digits == 0 && *pos == '0') {
+		exponent--;
+		continue;
+	    }
+	    if (++digits > 19) return fallback();
+	    mantissa = mantissa * 10 + (*pos - '0');
+	    exponent--;
+	}
+    }
+    if (!any) return fallback();  // Not a plain decimal: inf, nan or invalid
+    if (at(pos) == 'e' || at(pos) == 'E') {
+	const char* exp_pos = pos + 1;
+	bool exp_negative = at(exp_pos) == '-';
+	if (at(exp_pos) == '-' || at(exp_pos) == '+') exp_pos++;
+	if (at(exp_pos) >= '0' && at(exp_pos) <= '9') {
+	    int exp_value = 0;
+	    for (; at(exp_pos) >= '0' && at(exp_pos) <= '9'; exp_pos++) {
+		if (exp_value > 10000) return fallback();
+		exp_value = exp_value * 10 + (*exp_pos - '0');
+	    }
+	    exponent += exp_negative ? -exp_value : exp_value;
+	    pos = exp_pos;
+	}
+    }
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) return fallback();
+    *end = pos;
+    double value = static_cast<double>(mantissa);
+    value = exponent < 0 ? value / csv_pow10[-exponent] : value * csv_pow10[exponent];
+    return negative ? -value : value;
+}
+
+/**
+ * Formats a number like snprintf()'s "%g" does (six significant digits, trailing zeros removed, exponential notation
+ * below 1e-4 and from 1e6 up). The digits are obtained by scaling the number by an exact power of ten, whose only rounding
+ * error can't change them unless the number lies almost exactly halfway between two of them: those, and the numbers out
+ * of the range of the table, are left to snprintf().
+ * @param value The number.
+ * @param out Room for at least 32 characters.
+ * @return The length of the result.
+ */
+static int csvFormatDouble(double value, char* out) {
+    double magnitude = std::fabs(value);
+    if (magnitude == 0 || !std::isfinite(magnitude)) return snprintf(out, 32, "%g", value);
+    int exp10 = static_cast<int>(std::floor(std::log10(magnitude)));
+    int scale = 5 - exp10;
+    if (scale < -22 || scale > 21) return snprintf(out, 32, "%g", value);  // Leaves room for the correction below
+    double scaled = scale < 0 ? magnitude / csv_pow10[-scale] : magnitude * csv_pow10[scale];
+    if (scaled < 1e5) {  // log10() was off by one
+	exp10--;
+	scale++;
+	scaled = scale < 0 ? magnitude / csv_pow10[-scale] : magnitude * csv_pow10[scale];
+    }
+    double fraction = scaled - std::floor(scaled);
+    if (std::fabs(fraction - .5) < 1e-6) return snprintf(out, 32, "%g", value);
+    long digits_value = static_cast<long>(std::floor(scaled + .5));
+    if (digits_value >= 1000000) {
+	digits_value /= 10;
+	exp10++;
+    }
+    char digits[7];
+    for (int i = 5; i >= 0; i--, digits_value /= 10) digits[i] = static_cast<char>('0' + digits_value % 10);
+    int last = 5;  // The last significant digit
+    while (last > 0 && digits[last] == '0') last--;
+    int len = 0;
+    if (value < 0) out[len++] = '-';
+    if (exp10 < -4 || exp10 >= 6) {
+	out[len++] = digits[0];
+	if (last > 0) {
+	    out[len++] = '.';
+	    for (int i = 1; i <= last; i++) out[len++] = digits[i];
+	}
+	len += snprintf(out + len, 8, "e%c%02d", exp10 < 0 ? '-' : '+', std::abs(exp10));
+    } else if (exp10 >= 0) {
+	for (int i = 0; i <= exp10; i++) out[len++] = digits[i];
+	if (last > exp10) {
+	    out[len++] = '.';
+	    for (int i = exp10 + 1; i <= last; i++) out[len++] = digits[i];
+	}
+    } else {
+	out[len++] = '0';
+	out[len++] = '.';
+	for (int i = 0; i < -exp10 - 1; i++) out[len++] = '0';
+	for (int i = 0; i <= last; i++) out[len++] = digits[i];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * A part of a CSV file made of whole lines (the last line of the file may lack its newline), parsed by one task.
+ */
+struct CsvChunk {
+    const char *begin, *end;
+    size_t lines = 0, cells = 0;          // Counted by the first pass
+    size_t first_line = 0, first_cell = 0;  // Of the whole file, 0-based
+    std::string error;                      // The first error found by the second pass, if any
+};
+
+/**
+ * Counts the lines and the cells of a chunk, the way std::getline() would split them: a line ends at a newline (so the
+ * newline that ends the file doesn't begin another line), and a trailing comma doesn't begin another cell.
+ */
+static void csvCountChunk(CsvChunk& chunk) {
+    const char* pos = chunk.begin;
+    while (pos < chunk.end) {
+	const char* eol = static_cast<const char*>(memchr(pos, '\n', chunk.end - pos));
+	if (eol == nullptr) eol = chunk.end;
+	if (eol > pos) chunk.cells += std::count(pos, eol, ',') + (eol[-1] == ',' ? 0 : 1);
+	chunk.lines++;
+	pos = eol + 1;
+    }
+}
+
+/**
+ * Parses the cells of a chunk into their places in the matrix. Stops at the first malformed cell, recording where it is.
+ * @param chunk The chunk, counted and placed.
+ * @param out The elements of the whole matrix.
+ */
+static void csvParseChunk(CsvChunk& chunk, double* out) {
+    const char* pos = chunk.begin;
+    size_t line = chunk.first_line;
+    double* dst = out + chunk.first_cell;
+    while (pos < chunk.end) {
+	const char* eol = static_cast<const char*>(memchr(pos, '\n', chunk.end - pos));
+	if (eol == nullptr) eol = chunk.end;
+	size_t column = 0;
+	while (pos < eol) {  // A cell, unless it's what follows a trailing comma
+	    column++;
+	    const char* cell_end = static_cast<const char*>(memchr(pos, ',', eol - pos));
+	    if (cell_end == nullptr) cell_end = eol;
+	    const char* start = pos;
+	    while (start < cell_end && isspace(static_cast<unsigned char>(*start))) start++;
+	    const char* num_end = start;
+	    errno = 0;
+	    double value = start < cell_end ? csvParseDouble(start, cell_end, &num_end) : 0;
+	    if (num_end == start || errno == ERANGE) {
+		chunk.error = "Line " + std::to_string(line + 1) + ", column " + std::to_string(column) +
+			      (num_end == start ? ": empty or invalid cell detected. Are you trying to load malformed CSV?"
+						: ": out of range cell detected.");
+		return;
+	    }
+	    *dst++ = value;
+	    pos = cell_end == eol ? eol : cell_end + 1;
+	}
+	line++;
+	pos = eol + 1;
+    }
+}
+
+/**
+ * Reads a matrix from a CSV file: one row per line, with the cells separated by commas. The file is mapped in memory and
+ * split at line boundaries into chunks of about CSV_CHUNK_BYTES, which are parsed in parallel on the shared thread pool in
+ * two passes: the first one counts the lines and the cells of each chunk, so that the matrix is allocated once and each
+ * chunk knows where its cells go, the second one parses them in place (see csvParseDouble()). The same cells as the
+ * std::stod() of csvImportMatrixStream() are accepted (leading whitespace, and anything after the number, is ignored).
+ * @param path The path of the file.
+ * @param mat_rows The number of rows of the matrix.
+ * @param mat_cols The number of columns of the matrix.
+ * @return The elements, row by row.
+ * @throws std::runtime_error If the file can't be read, doesn't hold mat_rows lines and mat_rows*mat_cols cells, or a cell
+ * is empty or invalid (the message tells the line and column of the first one).
+ */
 std::vector<double> csvImportMatrix(const std::string& path, int mat_rows, int mat_cols) {
+    FileMapping mapping(path);
+    mapping.adviseWillNeed();
+    const char* begin = reinterpret_cast<const char*>(mapping.getBytes());
+    const char* end = begin + mapping.getLength();
+    std::vector<CsvChunk> chunks;
+    for (const char* pos = begin; pos < end;) {
+	const char* split = pos + std::min<size_t>(CSV_CHUNK_BYTES, end - pos);
+	const char* eol = split < end ? static_cast<const char*>(memchr(split, '\n', end - split)) : nullptr;
+	CsvChunk chunk;
+	chunk.begin = pos;
+	chunk.end = eol == nullptr ? end : eol + 1;
+	chunks.push_back(chunk);
+	pos = chunk.end;
+    }
+    ThreadPool& pool = getSharedThreadPool();
+    pool.parallelFor(0, chunks.size(), [&](size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) csvCountChunk(chunks[i]);
+    }, 1);
+    size_t lines = 0, cells = 0;
+    for (CsvChunk& chunk : chunks) {
+	chunk.first_line = lines;
+	chunk.first_cell = cells;
+	lines += chunk.lines;
+	cells += chunk.cells;
+    }
+    if (mat_rows < 0 || mat_cols < 0 || cells != static_cast<size_t>(mat_cols) * mat_rows ||
+	lines != static_cast<size_t>(mat_rows))
+	throw std::runtime_error("Can't interpret the contents of the file as a matrix of the given size (found " +
+				 std::to_string(lines) + " lines and " + std::to_string(cells) + " cells).");
+    std::vector<double> ret(cells);
+    pool.parallelFor(0, chunks.size(), [&](size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) csvParseChunk(chunks[i], ret.data());
+    }, 1);
+    for (const CsvChunk& chunk : chunks) {  // In order, so that the first error of the file is reported
+	if (!chunk.error.empty()) throw std::runtime_error(chunk.error);
+    }
+    return ret;
+}
+
+/**
+ * Writes a matrix to a CSV file, in the same format as csvExportMatrixStream() (six significant digits, cells separated by
+ * ", "), formatting the whole file in memory first (see csvFormatDouble()) so that it's written with a single call.
+ * @param csv_file_path The path of the file.
+ * @param mat The elements, row by row.
+ * @param mat_rows The number of rows of the matrix.
+ * @param mat_cols The number of columns of the matrix.
+ * @throws std::runtime_error If the sizes don't match or the file can't be written.
+ */
+void csvExportMatrix(const std::string& csv_file_path, const std::vector<double>& mat, int mat_rows, int mat_cols) {
+    if (mat.size() != static_cast<size_t>(mat_cols) * mat_rows)
+	throw std::runtime_error("Can't interpret the contents of the vector as a matrix of the given size.");
+    std::string contents;
+    contents.reserve(mat.size() * 12);
+    char cell[32];
+    int cols_left = mat_cols;
+    for (double elem : mat) {
+	int len = csvFormatDouble(elem, cell);
+	contents.append(cell, len);
+	if (--cols_left == 0) {
+	    contents += '\n';
+	    cols_left = mat_cols;
+	} else {
+	    contents += ", ";
+	}
+    }
+    FILE* file = fopen(csv_file_path.c_str(), "wb");
+    if (file == nullptr) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    bool ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) throw std::runtime_error("An I/O error occurred while writing the file.");
+}
+
+/*
+ * The original implementations, which go through a stream per line and per cell and flush every line. Kept to measure the
+ * ones above against them (see the Matrix I/O section of the benchmark window).
+ */
+
+std::vector<double> csvImportMatrixStream(const std::string& path, int mat_rows, int mat_cols) {
     std::ifstream file_ascii;
     file_ascii.open(path, std::ifstream::in);
     if (file_ascii.bad()) throw std::runtime_error("An I/O error occurred while trying to open the file for reading.");
@@ -54,7 +340,7 @@ std::vector<double> csvImportMatrix(const std::string& path, int mat_rows, int m
     return ret;
 }
 
-void csvExportMatrix(const std::string& csv_file_path, const std::vector<double>& mat, int mat_rows, int mat_cols) {
+void csvExportMatrixStream(const std::string& csv_file_path, const std::vector<double>& mat, int mat_rows, int mat_cols) {
     if (mat.size() != mat_cols * mat_rows)
 	throw std::runtime_error("Can't interpret the contents of the vector as a matrix of the given size.");
     std::ofstream file_ascii;
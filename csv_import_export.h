@@ -27,7 +27,11 @@
 #include <string>
 #include <vector>
 
+#define CSV_CHUNK_BYTES (1 << 20)  // The size of the parts of a file that csvImportMatrix() parses in parallel
+
 std::vector<double> csvImportMatrix(const std::string&, int, int);
 void csvExportMatrix(const std::string&, const std::vector<double>&, int, int);
+std::vector<double> csvImportMatrixStream(const std::string&, int, int);
+void csvExportMatrixStream(const std::string&, const std::vector<double>&, int, int);
 
 #endif  // PROJ2_CSV_IMPORT_EXPORT_H
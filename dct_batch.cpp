@@ -0,0 +1,471 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+/*
+ * Headless batch compressor: encodes whole directories or lists of images with the codec from img_codec.cpp, without
+ * touching SDL, OpenGL or ImGui, so that it can run on machines with no display.
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_JPEG
+#define STBI_NO_PNG
+#define STBI_NO_PSD
+#define STBI_NO_TGA
+#define STBI_NO_GIF
+#define STBI_NO_HDR
+#define STBI_NO_PIC
+#define STBI_NO_PNM
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bmp_reader.h"
+#include "dct_plan.h"
+#include "h_time.h"
+#include "img_codec.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+#define DCT_BATCH_VERSION "1.02"
+#define DCT_BATCH_DEFAULT_CHUNK 8
+#define DCT_BATCH_EXTENSION ".bmp"  // What is picked up from directories
+#define DCT_BATCH_OUT_EXTENSION ".dctc"
+
+struct BatchOptions {
+    int chunk_width = DCT_BATCH_DEFAULT_CHUNK;
+    int diag_cut = -1;  // Keep every coefficient
+    int quality = CODEC_DEFAULT_QUALITY;
+    int backend = COMPRESSOR_BACKEND_AUTO;
+    int precision = MYDCT_PRECISION_DOUBLE;
+    unsigned threads = 0;
+    std::string out_dir;  // Next to the inputs if empty
+    std::string wisdom_path;  // Plans aren't kept if empty
+    bool dry_run = false;
+    bool psnr = false;
+    bool streaming = false;
+    bool optimize_tables = false;  // When streaming, build the Huffman tables from a first pass over the image
+    bool use_stb = false;  // Load BMP files with stb_image instead of mapping them
+};
+
+struct BatchResult {
+    bool ok = false;
+    bool streamed = false;  // Loading and encoding have been timed together
+    std::string error;
+    std::string out_path;
+    int width = 0, height = 0;
+    CodecStats stats{};
+    nsec_t load_ns = 0, encode_ns = 0, total_ns = 0;
+    double psnr = .0f;
+};
+
+static void batchUsage(const char* argv0) {
+    fprintf(stderr,
+	    "Usage: %s [options] <file or directory>...\n"
+	    "Compresses every " DCT_BATCH_EXTENSION " image found in the given directories and every given file.\n"
+	    "  -c <size>     Chunk size (default: %d)\n"
+	    "  -d <cutoff>   Frequency cutoff (default: keep every coefficient)\n"
+	    "  -q <quality>  Quantization quality, 1 to 100 (default: %d)\n"
+	    "  -b <backend>  DCT backend: my, fast, fixed, batch, auto or cv (if built with OpenCV) (default: auto)\n"
+	    "  -P <type>     Transform precision: double, float, fixed32 or fixed16 (default: double)\n"
+	    "  -t <threads>  Worker threads (default: one per core)\n"
+	    "  -l <list>     Also read the inputs from a file, one per line (- for the standard input)\n"
+	    "  -o <dir>      Write the " DCT_BATCH_OUT_EXTENSION " files to this directory (default: next to the inputs)\n"
+	    "  -w <file>     Read the transform plans from this file, and write them back (default: measure them again)\n"
+	    "  -n            Don't write anything, just measure\n"
+	    "  -p            Decode each image again and report its PSNR\n"
+	    "  -L            Load BMP files with stb_image instead of mapping them (for comparison)\n"
+	    "  -s            Stream the images a band at a time instead of loading them whole (BMP only, not with -p)\n"
+	    "  -O            With -s, read each image twice to build its Huffman tables, instead of using the typical ones\n"
+	    "  -h            Show this help\n",
+	    argv0, DCT_BATCH_DEFAULT_CHUNK, CODEC_DEFAULT_QUALITY);
+}
+
+static bool batchParseInt(const char* arg, int min, int max, int& out) {
+    char* end;
+    long value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value < min || value > max) return false;
+    out = static_cast<int>(value);
+    return true;
+}
+
+static bool batchParseBackend(const std::string& name, int& out) {
+    static const char* names[] = {"cv", "my", "fast", "fixed", "auto", "batch"};  // Indexed by COMPRESSOR_BACKEND_*
+    for (int i = 0; i < 6; i++) {
+	if (name == names[i]) {
+	    out = i;
+	    return true;
+	}
+    }
+    return false;
+}
+
+static bool batchParsePrecision(const std::string& name, int& out) {
+    static const char* names[] = {"double", "float", "fixed32", "fixed16"};  // Indexed by MYDCT_PRECISION_*
+    for (int i = 0; i < 4; i++) {
+	if (name == names[i]) {
+	    out = i;
+	    return true;
+	}
+    }
+    return false;
+}
+
+static bool batchHasExtension(const std::string& path, const char* ext) {
+    size_t len = strlen(ext);
+    if (path.size() <= len) return false;
+    for (size_t i = 0; i < len; i++) {
+	if (tolower(static_cast<unsigned char>(path[path.size() - len + i])) != ext[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * Adds the images in a directory (not recursively), in alphabetical order.
+ * @throws std::runtime_error If the directory can't be read.
+ */
+static void batchListDirectory(const std::string& dir, std::vector<std::string>& paths) {
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) throw std::runtime_error("Unable to open directory \"" + dir + "\".");
+    std::vector<std::string> found;
+    while (struct dirent* entry = readdir(handle)) {
+	std::string path = dir + "/" + entry->d_name;
+	struct stat info;
+	if (batchHasExtension(path, DCT_BATCH_EXTENSION) && stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+	    found.push_back(path);
+    }
+    closedir(handle);
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+}
+
+static void batchAddInput(const std::string& path, std::vector<std::string>& paths) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+	batchListDirectory(path, paths);
+    else
+	paths.push_back(path);  // Errors are reported along with the results
+}
+
+static void batchReadList(const std::string& list, std::vector<std::string>& paths) {
+    std::ifstream file;
+    if (list != "-") {
+	file.open(list);
+	if (!file) throw std::runtime_error("Unable to open list \"" + list + "\".");
+    }
+    std::istream& in = list == "-" ? std::cin : file;
+    std::string line;
+    while (std::getline(in, line)) {
+	if (!line.empty() && line.back() == '\r') line.pop_back();
+	if (!line.empty()) batchAddInput(line, paths);
+    }
+}
+
+static std::string batchOutputPath(const std::string& path, const std::string& out_dir) {
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? path.substr(0, dot) : path;
+    if (!out_dir.empty()) stem = out_dir + "/" + (slash == std::string::npos ? stem : stem.substr(slash + 1));
+    return stem + DCT_BATCH_OUT_EXTENSION;
+}
+
+/**
+ * The codec drops the partial chunks at the right and bottom edges, so an image smaller than a chunk would be encoded as
+ * an empty one (and its PSNR, over no pixels at all, would be infinite).
+ * @throws std::runtime_error If the image doesn't hold a single whole chunk.
+ */
+static void batchCheckSize(int width, int height, int chunk_width) {
+    if (width < chunk_width || height < chunk_width)
+	throw std::runtime_error("The image (" + std::to_string(width) + "x" + std::to_string(height) +
+				 ") is smaller than a chunk (" + std::to_string(chunk_width) + "x" +
+				 std::to_string(chunk_width) + ").");
+}
+
+/**
+ * Loads, encodes and (unless it's a dry run) saves a single image.
+ * @throws std::runtime_error If any of the steps fails, or if the image is smaller than a chunk.
+ */
+static void batchCompressFile(const std::string& path, const BatchOptions& opt, BatchResult& res) {
+    timespec_t ts;
+    nsec_t start = HTime_GetNsDelta(&ts);
+    int diag_cut = opt.diag_cut < 0 ? 2 * opt.chunk_width - 1 : opt.diag_cut;
+    if (opt.streaming) {  // Reading and encoding are interleaved, so they're timed together
+	BmpReader reader(path);
+	batchCheckSize(reader.getWidth(), reader.getHeight(), opt.chunk_width);
+	if (!opt.dry_run) res.out_path = batchOutputPath(path, opt.out_dir);
+	codecEncodeStreaming(
+	    [&](int first, int count, unsigned char* dst, ptrdiff_t stride) { reader.readRows(first, count, dst, stride); },
+	    reader.getWidth(), reader.getHeight(), opt.chunk_width, diag_cut, opt.quality, opt.backend,
+	    opt.precision, opt.dry_run ? "/dev/null" : res.out_path, &res.stats, opt.optimize_tables);
+	res.width = reader.getWidth();
+	res.height = reader.getHeight();
+	res.encode_ns = res.total_ns = HTime_GetNsDelta(&ts) - start;
+	res.streamed = res.ok = true;
+	return;
+    }
+    int width, height;
+    const unsigned char* pixels;
+    ptrdiff_t stride;
+    std::unique_ptr<BmpMapping> mapping;
+    if (!opt.use_stb && batchHasExtension(path, ".bmp")) {
+	try {
+	    mapping.reset(new BmpMapping(path));
+	} catch (std::runtime_error&) {
+	    // stb_image might still be able to read it
+	}
+    }
+    std::unique_ptr<unsigned char, void (*)(void*)> buffer(nullptr, stbi_image_free);
+    if (mapping) {
+	pixels = mapping->getOrigin();
+	stride = mapping->getStride();
+	width = mapping->getWidth();
+	height = mapping->getHeight();
+    } else {
+	buffer.reset(stbi_load(path.c_str(), &width, &height, nullptr, 1));
+	if (!buffer) throw std::runtime_error(std::string("Unable to load image: ") + stbi_failure_reason());
+	pixels = buffer.get();
+	stride = width;
+    }
+    batchCheckSize(width, height, opt.chunk_width);
+    nsec_t loaded = HTime_GetNsDelta(&ts);
+    std::vector<unsigned char> stream =
+	codecEncode(pixels, stride, width, height, opt.chunk_width, diag_cut, opt.quality, opt.backend, opt.precision,
+		    &res.stats);
+    nsec_t encoded = HTime_GetNsDelta(&ts);
+    if (opt.psnr) {
+	CodecHeader header = codecReadHeader(stream);
+	std::vector<unsigned char> decoded(static_cast<size_t>(header.width) * header.height);
+	codecDecode(stream, decoded.data(), header.width, opt.backend, opt.precision);
+	res.psnr = codecPsnr(decoded.data(), header.width, pixels, stride, header.width, header.height);
+    }
+    if (!opt.dry_run) {
+	res.out_path = batchOutputPath(path, opt.out_dir);
+	codecSaveFile(res.out_path, stream);
+    }
+    res.width = width;
+    res.height = height;
+    res.load_ns = loaded - start;
+    res.encode_ns = encoded - loaded;
+    res.total_ns = HTime_GetNsDelta(&ts) - start;
+    res.ok = true;
+}
+
+static double batchMBs(size_t bytes, nsec_t ns) {
+    if (ns <= 0) return .0f;
+    return static_cast<double>(bytes) / (static_cast<double>(ns) / NSEC_PER_SEC) / 1e6;
+}
+
+static void batchPrintResult(const std::string& path, const BatchResult& res) {
+    if (!res.ok) {
+	printf("%s: FAILED: %s\n", path.c_str(), res.error.c_str());
+	return;
+    }
+    printf("%s: %dx%d, %zu -> %zu bytes (%.2f:1, %.3f bpp), ", path.c_str(), res.width, res.height, res.stats.raw_bytes,
+	   res.stats.encoded_bytes, static_cast<double>(res.stats.raw_bytes) / static_cast<double>(res.stats.encoded_bytes),
+	   8.0 * static_cast<double>(res.stats.encoded_bytes) / static_cast<double>(res.stats.raw_bytes));
+    if (res.streamed)
+	printf("streamed in %.2f ms", static_cast<double>(res.encode_ns) / NSEC_PER_MSEC);
+    else
+	printf("load %.2f ms, encode %.2f ms", static_cast<double>(res.load_ns) / NSEC_PER_MSEC,
+	       static_cast<double>(res.encode_ns) / NSEC_PER_MSEC);
+    printf(" (%.1f MB/s)", batchMBs(res.stats.raw_bytes, res.encode_ns));
+    if (!res.out_path.empty()) printf(", written to %s", res.out_path.c_str());
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    BatchOptions opt;
+    std::vector<std::string> paths;
+    int opt_char, threads;
+    try {
+	while ((opt_char = getopt(argc, argv, "c:d:q:b:P:t:l:o:w:npsOLh")) != -1) {
+	    bool valid = true;
+	    switch (opt_char) {
+		case 'c':
+		    valid = batchParseInt(optarg, 1, CODEC_MAX_CHUNK_WIDTH, opt.chunk_width);
+		    break;
+		case 'd':
+		    valid = batchParseInt(optarg, 0, 0xFFFF, opt.diag_cut);
+		    break;
+		case 'q':
+		    valid = batchParseInt(optarg, 1, 100, opt.quality);
+		    break;
+		case 'b':
+		    valid = batchParseBackend(optarg, opt.backend);
+		    break;
+		case 'P':
+		    valid = batchParsePrecision(optarg, opt.precision);
+		    break;
+		case 't':
+		    valid = batchParseInt(optarg, 1, THREAD_POOL_MAX_THREADS, threads);
+		    opt.threads = static_cast<unsigned>(threads);
+		    break;
+		case 'l':
+		    batchReadList(optarg, paths);
+		    break;
+		case 'o':
+		    opt.out_dir = optarg;
+		    break;
+		case 'w':
+		    opt.wisdom_path = optarg;
+		    break;
+		case 'n':
+		    opt.dry_run = true;
+		    break;
+		case 'p':
+		    opt.psnr = true;
+		    break;
+		case 's':
+		    opt.streaming = true;
+		    break;
+		case 'O':
+		    opt.optimize_tables = true;
+		    break;
+		case 'L':
+		    opt.use_stb = true;
+		    break;
+		case 'h':
+		    batchUsage(argv[0]);
+		    return EXIT_SUCCESS;
+		default:
+		    valid = false;
+	    }
+	    if (!valid) {
+		if (opt_char != '?') fprintf(stderr, "%s: invalid argument for -%c: %s\n", argv[0], opt_char, optarg);
+		batchUsage(argv[0]);
+		return 2;
+	    }
+	}
+	for (int i = optind; i < argc; i++) batchAddInput(argv[i], paths);
+    } catch (std::runtime_error& e) {
+	fprintf(stderr, "%s: %s\n", argv[0], e.what());
+	return 2;
+    }
+    if (paths.empty()) {
+	batchUsage(argv[0]);
+	return 2;
+    }
+    if (opt.streaming && opt.psnr) {
+	fprintf(stderr, "%s: -p can't be used with -s\n", argv[0]);
+	return 2;
+    }
+    if (opt.optimize_tables && !opt.streaming) {
+	fprintf(stderr, "%s: -O can only be used with -s\n", argv[0]);
+	return 2;
+    }
+    if (opt.backend == COMPRESSOR_BACKEND_CV && !dctPlanSupports(DCT_PLAN_KERNEL_CV, 2, 2, MYDCT_PRECISION_DOUBLE)) {
+	fprintf(stderr, "%s: cv::dct() isn't available, this build doesn't use OpenCV\n", argv[0]);
+	return 2;
+    }
+    if (opt.backend == COMPRESSOR_BACKEND_CV && opt.chunk_width % 2 != 0) {
+	fprintf(stderr, "%s: cv::dct() doesn't support odd chunk sizes\n", argv[0]);
+	return 2;
+    }
+    if (opt.threads != 0) setSharedThreadCount(opt.threads);
+    ThreadPool& pool = getSharedThreadPool();
+
+    // Plan the transform once, rather than have the threads measure it all at the same time
+    const char* kernel_name = dctPlanKernelName(DCT_PLAN_KERNEL_TYPED);
+    try {
+	if (!opt.wisdom_path.empty()) dctPlanLoadWisdom(opt.wisdom_path);
+	if (opt.precision == MYDCT_PRECISION_DOUBLE || opt.psnr)
+	    kernel_name = dctPlanKernelName(codecPlan(opt.backend, opt.chunk_width)->getKernel());
+    } catch (std::exception& e) {
+	fprintf(stderr, "%s: %s\n", argv[0], e.what());
+	return 2;
+    }
+
+    // With enough files, each thread compresses whole files (the codec runs serially inside the pool); otherwise the
+    // files go one at a time and the codec spreads each one's bands across the pool.
+    std::vector<BatchResult> results(paths.size());
+    std::mutex print_mtx;
+    auto compress = [&](size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) {
+	    try {
+		batchCompressFile(paths[i], opt, results[i]);
+	    } catch (std::exception& e) {
+		results[i].error = e.what();
+	    }
+	    std::lock_guard<std::mutex> lock(print_mtx);
+	    batchPrintResult(paths[i], results[i]);
+	    fflush(stdout);
+	}
+    };
+    timespec_t ts;
+    nsec_t start = HTime_GetNsDelta(&ts);
+    if (paths.size() >= pool.getThreadCount())
+	pool.parallelFor(0, paths.size(), compress, 1);
+    else
+	compress(0, paths.size());
+    nsec_t wall_ns = HTime_GetNsDelta(&ts) - start;
+    if (!opt.wisdom_path.empty()) {
+	try {
+	    dctPlanSaveWisdom(opt.wisdom_path);
+	} catch (std::runtime_error& e) {
+	    fprintf(stderr, "%s: %s: %s\n", argv[0], opt.wisdom_path.c_str(), e.what());
+	}
+    }
+
+    size_t failed = 0, raw_bytes = 0, encoded_bytes = 0;
+    nsec_t encode_ns = 0;
+    double psnr_sum = 0;
+    for (const BatchResult& res : results) {
+	if (!res.ok) {
+	    failed++;
+	    continue;
+	}
+	raw_bytes += res.stats.raw_bytes;
+	encoded_bytes += res.stats.encoded_bytes;
+	encode_ns += res.encode_ns;
+	psnr_sum += res.psnr;
+    }
+    size_t done = results.size() - failed;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("\n%zu files compressed, %zu failed, %u threads, %s, %.3f s, peak RSS %.1f MB\n", done, failed,
+	   pool.getThreadCount(), kernel_name, static_cast<double>(wall_ns) / NSEC_PER_SEC, usage.ru_maxrss / 1024.0);
+    if (done > 0) {
+	printf("%zu -> %zu bytes (%.2f:1, %.3f bpp)\n", raw_bytes, encoded_bytes,
+	       static_cast<double>(raw_bytes) / static_cast<double>(encoded_bytes),
+	       8.0 * static_cast<double>(encoded_bytes) / static_cast<double>(raw_bytes));
+	printf("Throughput: %.1f MB/s, %.2f files/s (wall clock); %.1f MB/s per thread encoding\n",
+	       batchMBs(raw_bytes, wall_ns), static_cast<double>(done) / (static_cast<double>(wall_ns) / NSEC_PER_SEC),
+	       batchMBs(raw_bytes, encode_ns));
+	if (opt.psnr) printf("Average PSNR: %.2f dB\n", psnr_sum / static_cast<double>(done));
+    }
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -23,41 +23,236 @@
 
 #include "dct_bench.h"
 
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
 
 #include "rnd_mat_gen.h"
+#include "background_job.h"
+#include "bench_harness.h"
 #include "csv_import_export.h"
+#include "dct_plan.h"
 #include "h_time.h"
+#include "mat_file.h"
 #include "my_dct.h"
+#include "my_dct_fixed.h"
+#include "my_dct_typed.h"
 #include "opencv2/opencv.hpp"
+#include "perf_counters.h"
+#include "thread_pool.h"
 
-long double benchDctNs(const std::vector<double>& in, int in_rows, int in_cols, std::vector<double>& out, uint impl) {
-    timespec_t ts;
-    std::vector<double> mat_temp(in_rows * in_cols);
-    nsec_t ts_start = 0, ts_end = -1;
-    if (impl == DCT_IMPL_CV) {
-	mat_temp = in;
-	cv::Mat cv_mat_in = cv::Mat(in_rows, in_cols, CV_64F, &mat_temp.front());
-	cv::Mat cv_mat_out = cv::Mat(in_rows, in_cols, CV_64F);
-	ts_start = HTime_GetNsDelta(&ts);  // Begin timing
-	cv::dct(cv_mat_in, cv_mat_out);
-	ts_end = HTime_GetNsDelta(&ts);  // End timing
-	mat_temp.clear();
-	mat_temp.assign(cv_mat_out.begin<double>(), cv_mat_out.end<double>());
+// The input of the benchmarks, shared by all the sections so that their runs can be reproduced and compared
+static int bench_seed = 1;
+static int bench_dist = RND_DIST_UNIFORM;
+
+// The shapes the Benchmarking section sweeps: how many times taller (> 0) or wider (< 0) than the square of each step
+static const char* bench_aspect_names[] = {"1:1", "2:1", "4:1", "8:1", "1:2", "1:4", "1:8"};
+static const int bench_aspect_factors[] = {1, 2, 4, 8, -2, -4, -8};
+
+/**
+ * A forward transform of a matrix by a given implementation, with everything but the transform itself done up front: the
+ * plan is made (or looked up in the wisdom), the workspace and the output are allocated and, for the typed
+ * implementation, the input is converted to the sample type (the fixed-point scale is chosen from the largest input, see
+ * MyTypedDCTFracBits()). Calling it runs and times the transform only, so that benchMeasure() can call it over and over
+ * and its hardware counters only see the transform. The input must outlive it.
+ */
+class BenchDctRun {
+   private:
+    std::function<long double()> timed;              // Runs the transform, returns the time it took in nanoseconds
+    std::function<void(std::vector<double>&)> fetch;  // Copies the result of the last run
+    int kernel;
+
+    template <typename T>
+    void setUpTyped(const std::vector<double>& in, int rows, int cols);
+
+   public:
+    BenchDctRun(const std::vector<double>& in, int rows, int cols, uint impl, int precision = MYDCT_PRECISION_DOUBLE);
+
+    long double operator()() const { return timed(); }
+    void getOutput(std::vector<double>& out) const { fetch(out); }
+    int getKernel() const { return kernel; }
+};
+
+/**
+ * The DCT_IMPL_MY_TYPED part of the constructor.
+ */
+template <typename T>
+void BenchDctRun::setUpTyped(const std::vector<double>& in, int rows, int cols) {
+    struct State {
+	MyTypedDCTWorkspace<T> ws;
+	std::vector<T> mat_in, mat_out;
+	int frac_bits;
+    };
+    std::shared_ptr<State> st = std::make_shared<State>();
+    double max_abs = 0;
+    for (double v : in) max_abs = std::max(max_abs, std::fabs(v));
+    st->frac_bits = MyTypedDCTFracBits<T>(max_abs, rows, cols);
+    st->ws.prepare(rows, cols);  // Builds the tables, which the other implementations have cached already
+    MyTypedFromDouble(in, st->mat_in, st->frac_bits);
+    st->mat_out.resize(in.size());
+    timed = [st, rows, cols]() {
+	timespec_t ts;
+	nsec_t ts_start = HTime_GetNsDelta(&ts);
+	MyTypedDDCT2(&st->mat_in.front(), cols, &st->mat_out.front(), cols, rows, cols, st->ws);
+	return static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+    };
+    fetch = [st](std::vector<double>& out) { MyTypedToDouble(st->mat_out, out, st->frac_bits); };
+}
+
+/**
+ * @return The plan kernel (DCT_PLAN_KERNEL_*) behind an implementation (DCT_IMPL_*), DCT_PLAN_KERNEL_AUTO for DCT_IMPL_PLAN.
+ */
+static int benchPlanKernel(uint impl) {
+    switch (impl) {
+	case DCT_IMPL_CV:
+	    return DCT_PLAN_KERNEL_CV;
+	case DCT_IMPL_MY:
+	    return DCT_PLAN_KERNEL_TABLE;
+	case DCT_IMPL_MY_NAIVE:
+	    return DCT_PLAN_KERNEL_NAIVE;
+	case DCT_IMPL_MY_FAST:
+	    return DCT_PLAN_KERNEL_FAST;
+	case DCT_IMPL_MY_FIXED:
+	    return DCT_PLAN_KERNEL_FIXED;
+	case DCT_IMPL_MY_SIMD:
+	    return DCT_PLAN_KERNEL_SIMD;
+	case DCT_IMPL_MY_PARALLEL:
+	    return DCT_PLAN_KERNEL_PARALLEL;
+	case DCT_IMPL_MY_BATCH:
+	case DCT_IMPL_MY_BATCH_SOA:
+	    return DCT_PLAN_KERNEL_BATCH;
+	default:
+	    return DCT_PLAN_KERNEL_AUTO;
+    }
+}
+
+/**
+ * Sets up a transform (see the class).
+ * @param in The input matrix.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param impl The DCT implementation (DCT_IMPL_*). All but DCT_IMPL_MY_TYPED and DCT_IMPL_MY_MONO go through a plan, bound
+ * to their kernel or, for DCT_IMPL_PLAN, picked by measuring them.
+ * @param precision The sample type (MYDCT_PRECISION_*), only used by DCT_IMPL_MY_TYPED.
+ * @throws std::invalid_argument If the implementation doesn't support the size of the matrix.
+ */
+BenchDctRun::BenchDctRun(const std::vector<double>& in, int rows, int cols, uint impl, int precision) {
+    if (impl == DCT_IMPL_MY_TYPED) {
+	kernel = DCT_PLAN_KERNEL_TYPED;
+	switch (precision) {
+	    case MYDCT_PRECISION_FLOAT:
+		setUpTyped<float>(in, rows, cols);
+		break;
+	    case MYDCT_PRECISION_FIXED32:
+		setUpTyped<int32_t>(in, rows, cols);
+		break;
+	    case MYDCT_PRECISION_FIXED16:
+		setUpTyped<int16_t>(in, rows, cols);
+		break;
+	    default:
+		setUpTyped<double>(in, rows, cols);
+	}
+	return;
+    }
+    struct State {
+	std::unique_ptr<DctPlan> plan;  // Empty for DCT_IMPL_MY_MONO, which is one-dimensional and not a plan's business
+	MyDCTWorkspace ws;
+	std::vector<double> out;
+    };
+    std::shared_ptr<State> st = std::make_shared<State>();
+    st->out.resize(in.size());
+    const double* src = in.empty() ? nullptr : &in.front();
+    if (impl == DCT_IMPL_MY_MONO) {
+	kernel = -1;
+	unsigned n = static_cast<unsigned>(in.size());
+	timed = [st, src, n]() {
+	    timespec_t ts;
+	    nsec_t ts_start = HTime_GetNsDelta(&ts);
+	    MyMDCT2(src, 1, &st->out.front(), 1, n, &st->ws);
+	    return static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+	};
+    } else {
+	st->plan.reset(new DctPlan(rows, cols, MYDCT_PRECISION_DOUBLE, 0, benchPlanKernel(impl)));
+	kernel = st->plan->getKernel();
+	timed = [st, src, cols]() {
+	    timespec_t ts;
+	    nsec_t ts_start = HTime_GetNsDelta(&ts);
+	    st->plan->forward(src, cols, &st->out.front(), cols, &st->ws);
+	    return static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+	};
+    }
+    fetch = [st](std::vector<double>& out) { out = st->out; };
+}
+
+/**
+ * Times a single forward transform of a matrix (see BenchDctRun, which leaves everything else out of the timed region).
+ * @param in The input matrix.
+ * @param in_rows The number of rows of the matrix.
+ * @param in_cols The number of columns of the matrix.
+ * @param out Filled with the transformed matrix.
+ * @param impl The DCT implementation (DCT_IMPL_*).
+ * @param precision The sample type (MYDCT_PRECISION_*), only used by DCT_IMPL_MY_TYPED.
+ * @param kernel If not nullptr, set to the kernel that did the work (DCT_PLAN_KERNEL_*, -1 for DCT_IMPL_MY_MONO).
+ * @return The elapsed time in nanoseconds.
+ * @throws std::invalid_argument If the implementation doesn't support the size of the matrix.
+ */
+long double benchDctNs(const std::vector<double>& in, int in_rows, int in_cols, std::vector<double>& out, uint impl,
+		       int precision = MYDCT_PRECISION_DOUBLE, int* kernel = nullptr) {
+    BenchDctRun run(in, in_rows, in_cols, impl, precision);
+    if (kernel != nullptr) *kernel = run.getKernel();
+    long double elapsed = run();
+    run.getOutput(out);
 #if OCV_DCT_DEBUG
+    if (impl == DCT_IMPL_CV) {
+	cv::Mat cv_mat_out = cv::Mat(in_rows, in_cols, CV_64F, &out.front());
 	DbgPrintCvMat(cv_mat_out);
-#endif
-    } else if (impl == DCT_IMPL_MY) {
-	ts_start = HTime_GetNsDelta(&ts);
-	mat_temp = MyDDCT2(in, in_rows);
-	ts_end = HTime_GetNsDelta(&ts);
-    } else if (impl == DCT_IMPL_MY_MONO) {
-	ts_start = HTime_GetNsDelta(&ts);
-	mat_temp = MyMDCT2(in);
-	ts_end = HTime_GetNsDelta(&ts);
     }
-    out = mat_temp;
-    return static_cast<long double>(ts_end - ts_start);
+#endif
+    return elapsed;
+}
+
+/**
+ * Transforms a sequence of contiguous square blocks, the way the image compressor does: one at a time, except for the
+ * batched kernel, through a plan bound to the implementation's kernel (or picked by measuring them, for DCT_IMPL_PLAN). The
+ * plan and the workspace are set up once, then the whole sequence is measured by benchMeasure(): an untimed call warms the
+ * workspace and the caches, and the median of 5 calls is kept.
+ * @param in The input blocks, stored one after the other.
+ * @param n The width of each block.
+ * @param out Filled with the transformed blocks.
+ * @param impl The DCT implementation: DCT_IMPL_CV, DCT_IMPL_MY, DCT_IMPL_MY_FIXED, DCT_IMPL_MY_SIMD, DCT_IMPL_PLAN, or
+ * DCT_IMPL_MY_BATCH and DCT_IMPL_MY_BATCH_SOA to transform all of them in one call (the latter reading the input as SoA
+ * blocks, which no plan does, so it calls MyBatchDDCT2() directly).
+ * @param kernel If not nullptr, set to the kernel that did the work (DCT_PLAN_KERNEL_*).
+ * @param progress If not nullptr, checked for cancellation between the calls (see benchMeasure()).
+ * @return The median time it took to transform all the blocks, in nanoseconds.
+ * @throws std::invalid_argument If the implementation doesn't support the size of the blocks.
+ */
+long double benchDctBlocksNs(const std::vector<double>& in, int n, std::vector<double>& out, uint impl,
+			     int* kernel = nullptr, JobProgress* progress = nullptr) {
+    size_t block_size = n * n, blocks = in.size() / block_size;
+    MyDCTWorkspace ws;
+    out.resize(blocks * block_size);
+    std::unique_ptr<DctPlan> plan;
+    if (impl != DCT_IMPL_MY_BATCH_SOA)  // Single-threaded, like the compressor's
+	plan.reset(new DctPlan(n, n, MYDCT_PRECISION_DOUBLE, 1, benchPlanKernel(impl)));
+    if (kernel != nullptr) *kernel = plan ? plan->getKernel() : DCT_PLAN_KERNEL_BATCH;
+    BenchConfig config;  // The calls transform thousands of blocks, they're slow enough to be timed one by one
+    config.warmup = 1;
+    config.repetitions = 5;
+    config.min_sample_ns = 0;
+    BenchStats stats = benchMeasure([&]() {
+	timespec_t ts;
+	nsec_t ts_start = HTime_GetNsDelta(&ts);
+	if (plan) {
+	    plan->forwardBlocks(&in.front(), &out.front(), blocks, &ws);
+	} else {
+	    MyBatchDDCT2(&in.front(), &out.front(), n, blocks, MYDCT_LAYOUT_SOA, &ws);
+	}
+	return static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+    }, config, progress);
+    return stats.median;
 }
 
 void dctBenchWindowInteractiveDemoSection() {
@@ -104,12 +299,16 @@ void dctBenchWindowInteractiveDemoSection() {
 	    snprintf((char*)&demo_status_msg, 512, "No matrix has been loaded.");
 	}
 	ImGui::SameLine();
-	// FIXME What if I load an odd-sized matrix?
 	if (ImGui::Button("Load from CSV File")) {
 	    mat_loaded = false;
 	    mat_processed = false;
 	    try {
-		mat_in = csvImportMatrix(csv_file_path, mat_rows, mat_cols);
+		if (matFileIsBinary(csv_file_path)) {  // The file knows its own size
+		    mat_in = matFileImport(csv_file_path, mat_rows, mat_cols);
+		    mat_is_square = mat_rows == mat_cols;
+		} else {
+		    mat_in = csvImportMatrix(csv_file_path, mat_rows, mat_cols);
+		}
 		snprintf((char*)&in_status_msg, 512, "File loaded successfully!");
 		mat_loaded = true;
 		snprintf((char*)&demo_status_msg, 512, "Ready.");
@@ -133,29 +332,29 @@ void dctBenchWindowInteractiveDemoSection() {
 	}
 	ImGui::Separator();
 	if (mat_loaded) {
-	    if (ImGui::Button("Start cv::dct()")) {
-		mat_processed = false;
-		elapsed = benchDctNs(mat_in, mat_rows, mat_cols, mat_out, DCT_IMPL_CV);
-		mat_processed = true;
+	    static const uint demo_impls[] = {DCT_IMPL_CV, DCT_IMPL_MY, DCT_IMPL_MY_FAST, DCT_IMPL_MY_SIMD,
+						 DCT_IMPL_MY_PARALLEL, DCT_IMPL_MY_FIXED, DCT_IMPL_MY_MONO};
+	    static const char* demo_labels[] = {"Start cv::dct()", "Start MyDDCT2()", "Start MyFastDDCT2()",
+						 "Start MySimdDDCT2()", "Start MyParallelDDCT2()", "Start MyFixedDDCT2()",
+						 "Start MyMDCT2()"};
+	    int demo_impl = -1;
+	    for (int i = 0; i < 7; i++) {
+		if (i > 0) ImGui::SameLine();
+		if (ImGui::Button(demo_labels[i])) demo_impl = static_cast<int>(demo_impls[i]);
 	    }
-	    ImGui::SameLine();
-	    if (ImGui::Button("Start MyDDCT2()")) {
+	    if (demo_impl != -1) {
 		mat_processed = false;
-		if (mat_rows != mat_cols) {
-		    snprintf((char*)&demo_status_msg, 512, "Can't perform the DDCT2 on a non-square matrix.");
-		} else {
-		    elapsed = benchDctNs(mat_in, mat_rows, mat_cols, mat_out, DCT_IMPL_MY);
-		    mat_processed = true;
-		}
-	    }
-	    ImGui::SameLine();
-	    if (ImGui::Button("Start MyMDCT2()")) {
-		mat_processed = false;
-		if (mat_rows != 1) {
+		if (demo_impl == DCT_IMPL_MY_FIXED && (mat_rows != mat_cols || !MyFixedDCTSupports(mat_cols))) {
+		    snprintf((char*)&demo_status_msg, 512, "The fixed-size kernels only support 4x4, 8x8 and 16x16 matrices.");
+		} else if (demo_impl == DCT_IMPL_MY_MONO && mat_rows != 1) {
 		    snprintf((char*)&demo_status_msg, 512, "Can't perform the MDCT2 on a matrix with more than one row.");
 		} else {
-		    elapsed = benchDctNs(mat_in, mat_rows, mat_cols, mat_out, DCT_IMPL_MY_MONO);
-		    mat_processed = true;
+		    try {  // cv::dct() only takes even sizes
+			elapsed = benchDctNs(mat_in, mat_rows, mat_cols, mat_out, demo_impl);
+			mat_processed = true;
+		    } catch (std::invalid_argument& e) {
+			snprintf((char*)&demo_status_msg, 512, "%s", e.what());
+		    }
 		}
 	    }
 	}
@@ -180,7 +379,11 @@ void dctBenchWindowInteractiveDemoSection() {
 	    ImGui::InputText("Results File Path", res_file_path, IM_ARRAYSIZE(res_file_path));
 	    if (ImGui::Button("Save to CSV File")) {
 		try {
-		    csvExportMatrix(res_file_path, mat_out, mat_rows, mat_cols);
+		    if (matFileIsBinary(res_file_path)) {
+			matFileExport(res_file_path, mat_out, mat_rows, mat_cols);
+		    } else {
+			csvExportMatrix(res_file_path, mat_out, mat_rows, mat_cols);
+		    }
 		    snprintf((char*)&out_status_msg, 512, "File written successfully!");
 		} catch (std::runtime_error& e) {
 		    snprintf((char*)&out_status_msg, 512, "Unable to write file \"%s\". Reason: %s", res_file_path, e.what());
@@ -192,71 +395,220 @@ void dctBenchWindowInteractiveDemoSection() {
     }
 }
 
+/**
+ * @return The given statistic (BENCH_STAT_*) out of a BenchStats for a size*size matrix: the times in milliseconds, the IPC
+ * (0 if the counters haven't been read) or the GFLOP/s.
+ */
+static double benchStatValue(const BenchStats& stats, int stat, int rows, int cols) {
+    if (stat == BENCH_STAT_IPC) return stats.perf.getIpc();
+    if (stat == BENCH_STAT_GFLOPS) return perfNominalDctFlops(rows, cols) / stats.median;
+    const double values[] = {stats.min, stats.median, stats.p95, stats.p99, stats.stddev};
+    return values[stat] / NSEC_PER_MSEC;
+}
+
 void dctBenchWindowBenchmarkingSection() {
+    static const uint impls[] = {DCT_IMPL_CV, DCT_IMPL_MY, DCT_IMPL_MY_FAST, DCT_IMPL_MY_SIMD, DCT_IMPL_PLAN};
+    static const char* impl_names[] = {"cv::dct()", "MyDDCT2()", "MyFastDDCT2()", "MySimdDDCT2()", "DctPlan"};
+    static const char* stat_names[] = {"Min", "Median", "p95", "p99", "Std. dev.", "IPC", "GFLOP/s"};  // Indexed by BENCH_STAT_*
+    static const std::string counters_error = PerfCounters().getError();  // Empty if they can be read
+    static BackgroundJob job;
     static bool done = false;
-    std::vector<double> discard;
     static char csv_file_path[128] = "./bench.csv";
     static char io_status_msg[512] = "";
-    static std::vector<double> cv_results_ms, my_results_ms;
+    static std::vector<BenchStats> results[5];  // Indexed like impls, guarded by the job
+    static std::vector<int> plan_kernels;       // The kernel the plan picked for each size, guarded by the job
+    static std::vector<int> sizes_rows, sizes_cols;
     static int steps = 8;
+    static int aspect = 0;  // Index in bench_aspect_names
+    static int simd_isa = -1;  // Automatic selection
+    static int simd_isa_used = MYDCT_ISA_SCALAR;
+    static BenchConfig config;
+    static float min_sample_us = static_cast<float>(BENCH_DEFAULT_MIN_SAMPLE_NS / 1000);
+    static bool pin = false;
+    static int pin_cpu = 0;
+    static bool pinned = false;
+    static int shown_stat = BENCH_STAT_MEDIAN;
+    if (job.poll()) {
+	if (job.wasCancelled()) {
+	    snprintf((char*)&io_status_msg, 512, "Benchmark cancelled after %zu of %zu measurements.",
+		     static_cast<size_t>(job.getProgress().steps_done), static_cast<size_t>(job.getProgress().steps_total));
+	} else if (!job.getError().empty()) {
+	    snprintf((char*)&io_status_msg, 512, "Benchmark failed. Reason: %s", job.getError().c_str());
+	} else {
+	    snprintf((char*)&io_status_msg, 512, "Benchmark completed in %.3Lf seconds%s.", job.getElapsedNs() / NSEC_PER_SEC,
+		     pin && !pinned ? " (the thread could not be pinned)" : "");
+	}
+    }
     if (ImGui::CollapsingHeader("Benchmarking")) {
-	if (ImGui::SliderInt("Steps", &steps, 4, 127)) done = false;
-	if (ImGui::Button("Start") && !done) {
-	    done = false;
-	    int cur_cols;
-	    std::vector<double> temp;
-	    cv_results_ms.clear();
-	    my_results_ms.clear();
-	    for(int i = 3; i <= steps; i++) {
-		cur_cols = 2*i;
-		temp = genRndMat(cur_cols, cur_cols); // MAYBE Use threads?
-		cv_results_ms.push_back(static_cast<double>(benchDctNs(temp, cur_cols, cur_cols, discard, DCT_IMPL_CV) / NSEC_PER_MSEC));
-		my_results_ms.push_back(static_cast<double>(benchDctNs(temp, cur_cols, cur_cols, discard, DCT_IMPL_MY) / NSEC_PER_MSEC));
-	    }
-	    done = true;
+	if (ImGui::SliderInt("Steps", &steps, 4, 127) && !job.isBusy()) done = false;
+	ImGui::Text("Aspect ratio (rows:cols):");
+	for (int a = 0; a < BENCH_ASPECT_COUNT; a++) {
+	    ImGui::SameLine();
+	    ImGui::RadioButton(bench_aspect_names[a], &aspect, a);
+	}
+	ImGui::SliderInt("Warm-up Calls", &config.warmup, 0, 20);
+	ImGui::SliderInt("Repetitions", &config.repetitions, 1, 200);
+	ImGui::SliderFloat("Min. Sample Time (us)", &min_sample_us, 0.0f, 10000.0f, "%.0f");
+	ImGui::Checkbox("Pin to Core", &pin);
+	if (pin) {
+	    ImGui::SameLine();
+	    ImGui::SliderInt("##pinCpu", &pin_cpu, 0, static_cast<int>(ThreadPool::getDefaultThreadCount()) - 1);
 	}
+	ImGui::Checkbox("Hardware Counters", &config.counters);
+	if (config.counters && !counters_error.empty()) {
+	    ImGui::SameLine();
+	    ImGui::TextWrapped("Unavailable, only the times will be measured. %s", counters_error.c_str());
+	}
+	ImGui::Text("SIMD path:");
 	ImGui::SameLine();
-	ImGui::TextWrapped("The window will freeze while performing the benchmark.");
-	if(steps > 100) {
+	ImGui::RadioButton("Auto", &simd_isa, -1);
+	for (int isa = MYDCT_ISA_SCALAR; isa <= MyDCTSimdDetectIsa(); isa++) {
+	    ImGui::SameLine();
+	    ImGui::RadioButton(MyDCTSimdIsaName(isa), &simd_isa, isa);
+	}
+	if (job.isBusy()) {
+	    ImGui::ProgressBar(job.getProgress().getFraction(), ImVec2(240, 0));
+	    ImGui::SameLine();
+	    if (ImGui::Button("Cancel")) job.cancel();
 	    ImGui::SameLine();
-	    ImGui::TextWrapped("WARNING: Benchmarking with more than 100 steps might take a while!");
+	    ImGui::TextWrapped("The results are shown as they come; the completed steps are kept if the benchmark is cancelled.");
+	} else {
+	    if (ImGui::Button("Start")) {
+		for (auto& impl_results : results) impl_results.clear();
+		plan_kernels.clear();
+		sizes_rows.clear();
+		sizes_cols.clear();
+		for (int i = 3; i <= steps; i++) {
+		    int rows = 2 * i, cols = 2 * i;  // The shorter side grows, the other one is a multiple of it
+		    if (bench_aspect_factors[aspect] > 0) {
+			rows *= bench_aspect_factors[aspect];
+		    } else {
+			cols *= -bench_aspect_factors[aspect];
+		    }
+		    sizes_rows.push_back(rows);
+		    sizes_cols.push_back(cols);
+		}
+		MyDCTSimdForceIsa(simd_isa);
+		simd_isa_used = MyDCTSimdActiveIsa();
+		config.min_sample_ns = static_cast<long double>(min_sample_us) * 1000;
+		config.cpu = pin ? pin_cpu : -1;
+		pinned = false;
+		BenchConfig m_config = config;
+		uint64_t m_seed = static_cast<uint32_t>(bench_seed);
+		int m_dist = bench_dist;
+		job.start(sizes_rows.size() * 5, [m_config, m_seed, m_dist](JobProgress& progress) {
+		    BenchPin pin_guard(m_config.cpu);
+		    pinned = pin_guard.isPinned();
+		    for (size_t s = 0; s < sizes_rows.size(); s++) {
+			int cur_rows = sizes_rows[s], cur_cols = sizes_cols[s];
+			std::vector<double> temp = genRndMat(cur_cols, cur_rows, m_seed, m_dist);
+			BenchStats step_results[5];
+			int kernel = DCT_PLAN_KERNEL_AUTO;
+			for (int k = 0; k < 5; k++) {
+			    BenchDctRun run(temp, cur_rows, cur_cols, impls[k]);  // Planned outside of the measurement
+			    if (impls[k] == DCT_IMPL_PLAN) kernel = run.getKernel();
+			    step_results[k] = benchMeasure([&]() { return run(); }, m_config, &progress);
+			    progress.step();
+			}
+			std::unique_lock<std::mutex> lock = job.lockResults();  // A step is published whole
+			for (int k = 0; k < 5; k++) results[k].push_back(step_results[k]);
+			plan_kernels.push_back(kernel);
+		    }
+		});
+		io_status_msg[0] = '\0';
+		done = true;
+	    }
+	    if (steps > 100) {
+		ImGui::SameLine();
+		ImGui::TextWrapped("WARNING: Benchmarking with more than 100 steps might take a while!");
+	    }
 	}
 	if (done) {
+	    std::unique_lock<std::mutex> lock = job.lockResults();
+	    int completed = static_cast<int>(results[0].size());
 	    ImGui::Separator();
-	    if (steps <= 64) {
-		if (ImGui::BeginTable("table2", steps - 1)) {
+	    ImGui::Text("Show:");
+	    for (int stat = BENCH_STAT_MIN; stat <= BENCH_STAT_GFLOPS; stat++) {
+		ImGui::SameLine();
+		ImGui::RadioButton(stat_names[stat], &shown_stat, stat);
+	    }
+	    if (completed == 0) {
+		ImGui::Text("No results yet.");
+	    } else if (completed <= 63) {
+		if (ImGui::BeginTable("table2", completed + 1)) {
 		    ImGui::TableNextColumn();
 		    ImGui::Text("Size");
-		    for (int i = 3; i <= steps; i++) {
-			ImGui::TableNextColumn();
-			ImGui::Text("%d", 2 * i);
-		    }
-		    ImGui::TableNextColumn();
-		    ImGui::Text("cv::dct()");
-		    for (auto res : cv_results_ms) {
+		    for (int i = 0; i < completed; i++) {
 			ImGui::TableNextColumn();
-			ImGui::Text("%4.3lf", res);
+			ImGui::Text("%dx%d", sizes_rows[i], sizes_cols[i]);
 		    }
-		    ImGui::TableNextColumn();
-		    ImGui::Text("MyDDCT2()");
-		    for (auto res : my_results_ms) {
+		    for (int k = 0; k < 5; k++) {
 			ImGui::TableNextColumn();
-			ImGui::Text("%4.3lf", res);
+			if (impls[k] == DCT_IMPL_MY_SIMD)
+			    ImGui::Text("%s [%s]", impl_names[k], MyDCTSimdIsaName(simd_isa_used));
+			else
+			    ImGui::Text("%s", impl_names[k]);
+			for (size_t i = 0; i < results[k].size(); i++) {
+			    const BenchStats& res = results[k][i];
+			    double value = benchStatValue(res, shown_stat, sizes_rows[i], sizes_cols[i]);
+			    ImGui::TableNextColumn();
+			    if (shown_stat == BENCH_STAT_IPC && value == 0) {
+				ImGui::Text("-");
+			    } else {
+				ImGui::Text(shown_stat >= BENCH_STAT_IPC ? "%4.2lf" : "%4.3lf", value);
+			    }
+			    if (ImGui::IsItemHovered()) {
+				char counters[256] = "";
+				const double* pc = res.perf.values;
+				int used = 0;
+				if (impls[k] == DCT_IMPL_PLAN)
+				    used = snprintf(counters, sizeof(counters), "\nKernel: %s", dctPlanKernelName(plan_kernels[i]));
+				if (res.perf.anyValid())
+				    snprintf(counters + used, sizeof(counters) - used,
+					     "\nPer call: %.0f cycles, %.0f instructions (IPC %.2f), %.0f L1D misses, %.0f LLC "
+					     "misses, %.0f branch misses",
+					     pc[PERF_COUNTER_CYCLES], pc[PERF_COUNTER_INSTRUCTIONS], res.perf.getIpc(),
+					     pc[PERF_COUNTER_L1D_MISSES], pc[PERF_COUNTER_LLC_MISSES], pc[PERF_COUNTER_BRANCH_MISSES]);
+				ImGui::SetTooltip("min %.4f, median %.4f, p95 %.4f, p99 %.4f, mean %.4f, std. dev. %.4f ms\n"
+						  "%d samples of %ld calls%s",
+						  res.min / NSEC_PER_MSEC, res.median / NSEC_PER_MSEC, res.p95 / NSEC_PER_MSEC,
+						  res.p99 / NSEC_PER_MSEC, res.mean / NSEC_PER_MSEC, res.stddev / NSEC_PER_MSEC,
+						  res.samples, res.batch, counters);
+			    }
+			}
 		    }
 		    ImGui::EndTable();
 		}
-		ImGui::TextWrapped("Results are expressed in milliseconds (ms).");
+		ImGui::TextWrapped("Results are expressed in milliseconds (ms) per call, instructions per cycle or GFLOP/s "
+				   "(counting the operations of the table-driven transform for every implementation); hover on a "
+				   "result for all the statistics and the hardware counters. The SIMD kernels ran on the %s path "
+				   "(detected: %s).",
+				   MyDCTSimdIsaName(simd_isa_used), MyDCTSimdIsaName(MyDCTSimdDetectIsa()));
 	    } else {
 		ImGui::TextWrapped("Cannot show results as they exceed the maximum allowable width (64) of ImGui::Table()!");
 	    }
 	    ImGui::InputText("CSV File Path", csv_file_path, IM_ARRAYSIZE(csv_file_path));
-	    if (ImGui::Button("Export to CSV") && done) {
+	    if (ImGui::Button("Export to CSV") && completed > 0) {
 		try {
-		    std::vector<double> results_ms = {};
-		    results_ms.reserve(cv_results_ms.size() + my_results_ms.size());
-		    results_ms.insert(results_ms.end(), cv_results_ms.begin(), cv_results_ms.end());
-		    results_ms.insert(results_ms.end(), my_results_ms.begin(), my_results_ms.end());
-		    csvExportMatrix(csv_file_path, results_ms, 2, steps - 2);
+		    std::vector<double> values = {};
+		    values.reserve(5 * completed);
+		    for (auto& impl_results : results) {
+			for (size_t i = 0; i < impl_results.size(); i++)
+			    values.push_back(benchStatValue(impl_results[i], shown_stat, sizes_rows[i], sizes_cols[i]));
+		    }
+		    csvExportMatrix(csv_file_path, values, 5, completed);
+		    snprintf((char*)&io_status_msg, 512, "File written successfully (%s)!", stat_names[shown_stat]);
+		} catch (std::runtime_error& e) {
+		    snprintf((char*)&io_status_msg, 512, "Unable to write file \"%s\". Reason: %s", csv_file_path, e.what());
+		}
+	    }
+	    ImGui::SameLine();
+	    if (ImGui::Button("Export All Statistics") && completed > 0) {
+		try {
+		    std::vector<BenchStats> all;
+		    for (auto& impl_results : results) all.insert(all.end(), impl_results.begin(), impl_results.end());
+		    benchExportCsv(csv_file_path, std::vector<std::string>(impl_names, impl_names + 5), sizes_rows, sizes_cols,
+				   all);
 		    snprintf((char*)&io_status_msg, 512, "File written successfully!");
 		} catch (std::runtime_error& e) {
 		    snprintf((char*)&io_status_msg, 512, "Unable to write file \"%s\". Reason: %s", csv_file_path, e.what());
@@ -268,11 +620,546 @@ void dctBenchWindowBenchmarkingSection() {
     }
 }
 
+void dctBenchWindowFixedKernelsSection() {
+    static const int sizes[] = {4, 8, 16};
+    static const uint impls[] = {DCT_IMPL_CV, DCT_IMPL_MY, DCT_IMPL_MY_FIXED};
+    static bool done = false;
+    static int blocks = 4096;
+    static double results_ns[3][3];  // [size][impl], per block
+    std::vector<double> discard;
+    if (ImGui::CollapsingHeader("Fixed-size Kernels")) {
+	if (ImGui::SliderInt("Blocks", &blocks, 256, 65536)) done = false;
+	if (ImGui::Button("Start##fixed")) {
+	    for (int s = 0; s < 3; s++) {
+		// The blocks are stacked on top of each other, so each one is a tile of the same field
+		std::vector<double> temp = genRndMat(sizes[s], sizes[s] * blocks, static_cast<uint32_t>(bench_seed), bench_dist);
+		for (int i = 0; i < 3; i++) {
+		    results_ns[s][i] = static_cast<double>(benchDctBlocksNs(temp, sizes[s], discard, impls[i]) / blocks);
+		}
+	    }
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Transforms the blocks one at a time, like the image compressor does.");
+	if (done) {
+	    ImGui::Separator();
+	    if (ImGui::BeginTable("table_fixed", 4)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Size");
+		ImGui::TableNextColumn();
+		ImGui::Text("cv::dct()");
+		ImGui::TableNextColumn();
+		ImGui::Text("MyDDCT2()");
+		ImGui::TableNextColumn();
+		ImGui::Text("MyFixedDDCT2()");
+		for (int s = 0; s < 3; s++) {
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%dx%d", sizes[s], sizes[s]);
+		    for (int i = 0; i < 3; i++) {
+			ImGui::TableNextColumn();
+			ImGui::Text("%4.1lf", results_ns[s][i]);
+		    }
+		}
+		ImGui::EndTable();
+	    }
+	    ImGui::TextWrapped("Results are expressed in nanoseconds per block (ns), from the median of 5 runs.");
+	}
+    }
+}
+
+void dctBenchWindowBatchedBlocksSection() {
+    static const int sizes[] = {4, 8, 12, 16, 20, 24, 28, 32};
+    static const uint impls[] = {DCT_IMPL_MY, DCT_IMPL_MY_FIXED, DCT_IMPL_MY_BATCH, DCT_IMPL_MY_BATCH_SOA, DCT_IMPL_PLAN};
+    static BackgroundJob job;
+    static bool done = false;
+    static int blocks = 4096;
+    static char batched_status_msg[512] = "";
+    // Guarded by the job: [size][impl] in millions of blocks per second (0 where unsupported), the kernel the plan picked
+    // for each size and the number of sizes measured so far
+    static double results_mbps[8][5];
+    static int plan_kernels[8];
+    static int sizes_done = 0;
+    if (job.poll()) {
+	if (job.wasCancelled()) {
+	    snprintf((char*)&batched_status_msg, 512, "Benchmark cancelled.");
+	} else if (!job.getError().empty()) {
+	    snprintf((char*)&batched_status_msg, 512, "Benchmark failed. Reason: %s", job.getError().c_str());
+	} else {
+	    batched_status_msg[0] = '\0';
+	}
+    }
+    if (ImGui::CollapsingHeader("Batched Blocks")) {
+	if (ImGui::SliderInt("Blocks##batched", &blocks, 256, 65536) && !job.isBusy()) done = false;
+	if (job.isBusy()) {
+	    ImGui::ProgressBar(job.getProgress().getFraction(), ImVec2(240, 0));
+	    ImGui::SameLine();
+	    if (ImGui::Button("Cancel##batched")) job.cancel();
+	} else if (ImGui::Button("Start##batched")) {
+	    sizes_done = 0;
+	    int m_blocks = blocks;
+	    uint64_t m_seed = static_cast<uint32_t>(bench_seed);
+	    int m_dist = bench_dist;
+	    job.start(8 * 5, [m_blocks, m_seed, m_dist](JobProgress& progress) {
+		std::vector<double> discard;
+		for (int s = 0; s < 8; s++) {
+		    // The blocks are stacked on top of each other, so each one is a tile of the same field
+		    std::vector<double> temp = genRndMat(sizes[s], sizes[s] * m_blocks, m_seed, m_dist);
+		    double size_results[5];
+		    int kernel = DCT_PLAN_KERNEL_AUTO;
+		    for (int i = 0; i < 5; i++) {
+			size_results[i] = 0;
+			if (impls[i] != DCT_IMPL_MY_FIXED || MyFixedDCTSupports(sizes[s])) {
+			    int impl_kernel;
+			    long double elapsed =
+				benchDctBlocksNs(temp, sizes[s], discard, impls[i], &impl_kernel, &progress);
+			    size_results[i] = static_cast<double>(m_blocks * 1000.0L / elapsed);
+			    if (impls[i] == DCT_IMPL_PLAN) kernel = impl_kernel;
+			}
+			progress.step();
+		    }
+		    std::unique_lock<std::mutex> lock = job.lockResults();
+		    std::copy(size_results, size_results + 5, results_mbps[s]);
+		    plan_kernels[s] = kernel;
+		    sizes_done = s + 1;
+		}
+	    });
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Transforms the blocks one at a time, then all of them with a single MyBatchDDCT2() call (%u "
+			   "blocks per SIMD strip), then through a single-threaded plan. %s", MYDCT_BATCH_LANES,
+			   batched_status_msg);
+	if (done) {
+	    std::unique_lock<std::mutex> lock = job.lockResults();
+	    int completed = sizes_done;
+	    ImGui::Separator();
+	    if (ImGui::BeginTable("table_batched", 6)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Size");
+		ImGui::TableNextColumn();
+		ImGui::Text("MyDDCT2()");
+		ImGui::TableNextColumn();
+		ImGui::Text("MyFixedDDCT2()");
+		ImGui::TableNextColumn();
+		ImGui::Text("Batch, interleaved");
+		ImGui::TableNextColumn();
+		ImGui::Text("Batch, SoA");
+		ImGui::TableNextColumn();
+		ImGui::Text("DctPlan");
+		for (int s = 0; s < completed; s++) {
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%dx%d", sizes[s], sizes[s]);
+		    for (int i = 0; i < 5; i++) {
+			ImGui::TableNextColumn();
+			if (results_mbps[s][i] <= 0) {
+			    ImGui::Text("-");
+			} else if (impls[i] == DCT_IMPL_PLAN) {
+			    ImGui::Text("%4.2lf (%s)", results_mbps[s][i], dctPlanKernelName(plan_kernels[s]));
+			} else {
+			    ImGui::Text("%4.2lf", results_mbps[s][i]);
+			}
+		    }
+		}
+		ImGui::EndTable();
+	    }
+	    ImGui::TextWrapped("Results are expressed in millions of blocks per second (Mblocks/s), from the median of 5 runs. "
+			       "Interleaved blocks are stored one after the other, SoA ones coefficient by coefficient (block "
+			       "b's element i at i * blocks + b).");
+	}
+    }
+}
+
+void dctBenchWindowMatrixIoSection() {
+    static const char* format_names[] = {"CSV (streams)", "CSV", "Binary"};
+    static BackgroundJob job;
+    static bool done = false;
+    static int mat_size = 1024;
+    static char scratch_path[128] = "./io_bench";
+    static char io_status_msg[512] = "";
+    static double write_ms[3], read_ms[3], file_mb[3];  // Indexed like format_names, guarded by the job
+    static int formats_done = 0;  // Guarded by the job
+    if (job.poll()) {
+	if (job.wasCancelled()) {
+	    snprintf((char*)&io_status_msg, 512, "Benchmark cancelled (the scratch file may be left behind).");
+	} else if (!job.getError().empty()) {
+	    snprintf((char*)&io_status_msg, 512, "Benchmark failed. Reason: %s", job.getError().c_str());
+	} else {
+	    io_status_msg[0] = '\0';
+	}
+    }
+    if (ImGui::CollapsingHeader("Matrix I/O")) {
+	if (ImGui::SliderInt("Matrix Size##io", &mat_size, 64, 4096) && !job.isBusy()) done = false;
+	ImGui::InputText("Scratch File Path", scratch_path, IM_ARRAYSIZE(scratch_path));
+	if (job.isBusy()) {
+	    ImGui::ProgressBar(job.getProgress().getFraction(), ImVec2(240, 0));
+	    ImGui::SameLine();
+	    if (ImGui::Button("Cancel##io")) job.cancel();
+	} else if (ImGui::Button("Start##io")) {
+	    formats_done = 0;
+	    int m_size = mat_size;
+	    std::string m_path = scratch_path;
+	    uint64_t m_seed = static_cast<uint32_t>(bench_seed);
+	    int m_dist = bench_dist;
+	    job.start(6, [m_size, m_path, m_seed, m_dist](JobProgress& progress) {
+		std::vector<double> mat = genRndMat(m_size, m_size, m_seed, m_dist);
+		BenchConfig config;  // The calls are slow enough to be timed one by one
+		config.warmup = 1;
+		config.repetitions = 5;
+		config.min_sample_ns = 0;
+		for (int f = 0; f < 3; f++) {
+		    std::string path = m_path + (f == 2 ? MATFILE_EXTENSION : ".csv");
+		    BenchStats write_stats = benchMeasure([&]() {
+			timespec_t ts;
+			nsec_t ts_start = HTime_GetNsDelta(&ts);
+			if (f == 0) {
+			    csvExportMatrixStream(path, mat, m_size, m_size);
+			} else if (f == 1) {
+			    csvExportMatrix(path, mat, m_size, m_size);
+			} else {
+			    matFileExport(path, mat, m_size, m_size);
+			}
+			return static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+		    }, config, &progress);
+		    progress.step();
+		    BenchStats read_stats = benchMeasure([&]() {
+			timespec_t ts;
+			int rows = m_size, cols = m_size;
+			nsec_t ts_start = HTime_GetNsDelta(&ts);
+			std::vector<double> read = f == 0   ? csvImportMatrixStream(path, rows, cols)
+						   : f == 1 ? csvImportMatrix(path, rows, cols)
+							    : matFileImport(path, rows, cols);
+			long double elapsed = static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+			if (read.size() != mat.size()) throw std::runtime_error("The matrix read back has the wrong size.");
+			return elapsed;
+		    }, config, &progress);
+		    progress.step();
+		    std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+		    double size_mb = static_cast<double>(file.tellg()) / (1 << 20);
+		    remove(path.c_str());
+		    std::unique_lock<std::mutex> lock = job.lockResults();
+		    write_ms[f] = write_stats.median / NSEC_PER_MSEC;
+		    read_ms[f] = read_stats.median / NSEC_PER_MSEC;
+		    file_mb[f] = size_mb;
+		    formats_done = f + 1;
+		}
+	    });
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Writes a random matrix to the scratch file and reads it back in each format (the file is then "
+			   "removed). %s", io_status_msg);
+	if (done) {
+	    std::unique_lock<std::mutex> lock = job.lockResults();
+	    int completed = formats_done;
+	    double mat_mb = static_cast<double>(mat_size) * mat_size * sizeof(double) / (1 << 20);
+	    ImGui::Separator();
+	    if (ImGui::BeginTable("table_io", 4)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Format");
+		ImGui::TableNextColumn();
+		ImGui::Text("File (MB)");
+		ImGui::TableNextColumn();
+		ImGui::Text("Write (MB/s)");
+		ImGui::TableNextColumn();
+		ImGui::Text("Read (MB/s)");
+		for (int f = 0; f < completed; f++) {
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%s", format_names[f]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.1lf", file_mb[f]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.1lf", mat_mb / write_ms[f] * 1000);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.1lf", mat_mb / read_ms[f] * 1000);
+		}
+		ImGui::EndTable();
+	    }
+	    ImGui::TextWrapped("Throughputs are in MB of doubles (%.1lf MB) per second, from the median of 5 runs. The file "
+			       "is usually in the page cache, so this measures the formatting and parsing rather than the "
+			       "disk.", mat_mb);
+	}
+    }
+}
+
+void dctBenchWindowThreadScalingSection() {
+    static bool done = false;
+    static bool identical = true;
+    static int mat_size = 512;
+    static int max_threads = static_cast<int>(ThreadPool::getDefaultThreadCount());
+    static std::vector<double> results_ms;
+    static std::vector<float> speedups;  // ImGui plots floats
+    std::vector<double> out;
+    if (ImGui::CollapsingHeader("Thread Scaling")) {
+	if (ImGui::SliderInt("Matrix Size", &mat_size, 64, 2048)) done = false;
+	if (ImGui::SliderInt("Max Threads", &max_threads, 1, 64)) done = false;
+	if (BackgroundJob::getActiveCount() > 0) {  // The thread pool can't be resized under its feet
+	    ImGui::TextWrapped("Wait for the running jobs to finish.");
+	} else if (ImGui::Button("Start##threads")) {
+	    std::vector<double> temp = genRndMat(mat_size, mat_size, static_cast<uint32_t>(bench_seed), bench_dist);
+	    std::vector<double> reference = MyDDCT2(temp, mat_size, mat_size);
+	    results_ms.clear();
+	    speedups.clear();
+	    identical = true;
+	    BenchConfig config;
+	    config.warmup = 1;
+	    config.repetitions = 5;
+	    for (int threads = 1; threads <= max_threads; threads++) {
+		setSharedThreadCount(threads);
+		BenchDctRun run(temp, mat_size, mat_size, DCT_IMPL_MY_PARALLEL);  // Set up for the threads the pool has now
+		BenchStats stats = benchMeasure([&]() { return run(); }, config);
+		run.getOutput(out);
+		results_ms.push_back(stats.median / NSEC_PER_MSEC);
+		speedups.push_back(static_cast<float>(results_ms.front() / results_ms.back()));
+		identical = identical && out == reference;
+	    }
+	    setSharedThreadCount(0);  // Back to one thread per core
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Runs MyParallelDDCT2() with 1 to Max Threads threads (%u hardware threads detected), keeping "
+			   "the median of 5 runs after an untimed one.", ThreadPool::getDefaultThreadCount());
+	if (done) {
+	    ImGui::Separator();
+	    ImGui::PlotLines("Speedup", &speedups.front(), static_cast<int>(speedups.size()), 0, nullptr, 0.0f,
+			     static_cast<float>(max_threads), ImVec2(0, 120));
+	    if (ImGui::BeginTable("table_threads", 3)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Threads");
+		ImGui::TableNextColumn();
+		ImGui::Text("Time (ms)");
+		ImGui::TableNextColumn();
+		ImGui::Text("Speedup");
+		for (size_t i = 0; i < results_ms.size(); i++) {
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%zu", i + 1);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%4.3lf", results_ms[i]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.2fx", speedups[i]);
+		}
+		ImGui::EndTable();
+	    }
+	    ImGui::TextWrapped("%s", identical ? "Every run matched MyDDCT2() exactly."
+					       : "WARNING: some runs did not match MyDDCT2() exactly!");
+	}
+    }
+}
+
+/**
+ * @return The PSNR of a matrix against a reference one, taking the largest magnitude of the reference as the peak.
+ */
+static double benchPsnr(const std::vector<double>& reference, const std::vector<double>& other) {
+    double peak = 0, sq_err = 0;
+    for (size_t i = 0; i < reference.size(); i++) {
+	peak = std::max(peak, std::fabs(reference[i]));
+	sq_err += (reference[i] - other[i]) * (reference[i] - other[i]);
+    }
+    if (sq_err == 0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(peak * peak * reference.size() / sq_err);
+}
+
+/**
+ * Transforms a matrix back and forth with samples of type T.
+ * @return The PSNR of the result against the input.
+ */
+template <typename T>
+static double benchTypedRoundTripPsnr(const std::vector<double>& in, int rows, int cols) {
+    double max_abs = 0;
+    for (double v : in) max_abs = std::max(max_abs, std::fabs(v));
+    int frac_bits = MyTypedDCTFracBits<T>(max_abs, rows, cols);
+    MyTypedDCTWorkspace<T> ws;
+    std::vector<T> mat;
+    std::vector<double> out;
+    MyTypedFromDouble(in, mat, frac_bits);
+    MyTypedDDCT2(&mat.front(), cols, &mat.front(), cols, rows, cols, ws);
+    MyTypedDIDCT2(&mat.front(), cols, &mat.front(), cols, rows, cols, ws);
+    MyTypedToDouble(mat, out, frac_bits);
+    return benchPsnr(in, out);
+}
+
+void dctBenchWindowPrecisionSection() {
+    static bool done = false;
+    static int mat_size = 64;
+    static double results_ms[4], coeff_psnr[4], round_trip_psnr[4];  // Indexed by MYDCT_PRECISION_*
+    if (ImGui::CollapsingHeader("Precision")) {
+	if (ImGui::SliderInt("Matrix Size##precision", &mat_size, 4, 1024)) done = false;
+	if (ImGui::Button("Start##precision")) {
+	    std::vector<double> temp = genRndMat(mat_size, mat_size, static_cast<uint32_t>(bench_seed), bench_dist);
+	    std::vector<double> reference, out;
+	    BenchConfig config;
+	    config.warmup = 1;
+	    config.repetitions = 5;
+	    for (int p = MYDCT_PRECISION_DOUBLE; p <= MYDCT_PRECISION_FIXED16; p++) {
+		BenchDctRun run(temp, mat_size, mat_size, DCT_IMPL_MY_TYPED, p);
+		BenchStats stats = benchMeasure([&]() { return run(); }, config);
+		run.getOutput(out);
+		results_ms[p] = stats.median / NSEC_PER_MSEC;
+		if (p == MYDCT_PRECISION_DOUBLE) reference = out;
+		coeff_psnr[p] = benchPsnr(reference, out);
+	    }
+	    round_trip_psnr[MYDCT_PRECISION_DOUBLE] = benchTypedRoundTripPsnr<double>(temp, mat_size, mat_size);
+	    round_trip_psnr[MYDCT_PRECISION_FLOAT] = benchTypedRoundTripPsnr<float>(temp, mat_size, mat_size);
+	    round_trip_psnr[MYDCT_PRECISION_FIXED32] = benchTypedRoundTripPsnr<int32_t>(temp, mat_size, mat_size);
+	    round_trip_psnr[MYDCT_PRECISION_FIXED16] = benchTypedRoundTripPsnr<int16_t>(temp, mat_size, mat_size);
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Runs MyTypedDDCT2() with each sample type on the same random matrix, keeping the median of 5 "
+			   "runs after an untimed one.");
+	if (done) {
+	    ImGui::Separator();
+	    if (ImGui::BeginTable("table_precision", 5)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Samples");
+		ImGui::TableNextColumn();
+		ImGui::Text("Time (ms)");
+		ImGui::TableNextColumn();
+		ImGui::Text("Speedup");
+		ImGui::TableNextColumn();
+		ImGui::Text("PSNR vs double (dB)");
+		ImGui::TableNextColumn();
+		ImGui::Text("Round trip PSNR (dB)");
+		for (int p = MYDCT_PRECISION_DOUBLE; p <= MYDCT_PRECISION_FIXED16; p++) {
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%s", MyDCTPrecisionName(p));
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%4.3lf", results_ms[p]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.2fx", results_ms[MYDCT_PRECISION_DOUBLE] / results_ms[p]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.1lf", coeff_psnr[p]);
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%.1lf", round_trip_psnr[p]);
+		}
+		ImGui::EndTable();
+	    }
+	    ImGui::TextWrapped("The PSNRs take the largest magnitude of the reference as the peak; inf means identical. The "
+			       "fixed-point scale is chosen so that no coefficient can overflow, which costs 16-bit samples "
+			       "more and more precision as the matrix grows.");
+	}
+    }
+}
+
+void dctBenchWindowInputSection() {
+    if (ImGui::CollapsingHeader("Input")) {
+	ImGui::InputInt("Seed##bench", &bench_seed);
+	ImGui::SameLine();
+	if (ImGui::Button("New Seed##bench")) bench_seed = static_cast<int>(rndNewSeed() & 0x7fffffff);
+	for (int dist = RND_DIST_UNIFORM; dist <= RND_DIST_SMOOTH; dist++) {
+	    if (dist != RND_DIST_UNIFORM) ImGui::SameLine();
+	    ImGui::RadioButton(rndDistName(dist), &bench_dist, dist);
+	}
+	ImGui::TextWrapped("The random matrices the benchmarks run on. The same seed gives the same matrices, whatever "
+			   "the number of threads; the smooth field looks more like an image than uniform noise does.");
+    }
+}
+
+void dctBenchWindowPlansSection() {
+    static bool done = false;
+    static int rows = 64, cols = 64;
+    static char wisdom_path[128] = DCT_PLAN_WISDOM_FILE;
+    static char plan_status_msg[512] = "";
+    static std::unique_ptr<DctPlan> plan;
+    if (ImGui::CollapsingHeader("Plans")) {
+	if (ImGui::SliderInt("Rows##plan", &rows, 2, 1024)) done = false;
+	if (ImGui::SliderInt("Cols##plan", &cols, 2, 1024)) done = false;
+	if (ImGui::Button("Plan")) {
+	    plan.reset(new DctPlan(rows, cols));
+	    done = true;
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("Plans a double precision transform on the shared thread pool (%u threads): times the kernels "
+			   "that support the size, unless the wisdom already knows the winner.",
+			   getSharedThreadPool().getThreadCount());
+	if (done) {
+	    ImGui::Separator();
+	    if (plan->isFromWisdom()) {
+		ImGui::TextWrapped("%s, from the wisdom: forget it to measure the kernels again.",
+				   dctPlanKernelName(plan->getKernel()));
+	    } else if (ImGui::BeginTable("table_plan", 2)) {
+		ImGui::TableNextColumn();
+		ImGui::Text("Kernel");
+		ImGui::TableNextColumn();
+		ImGui::Text("Time (us)");
+		for (int k = 0; k < DCT_PLAN_KERNEL_COUNT; k++) {
+		    if (!dctPlanSupports(k, plan->getRows(), plan->getCols(), plan->getPrecision())) continue;
+		    ImGui::TableNextColumn();
+		    ImGui::Text("%s%s", dctPlanKernelName(k), k == plan->getKernel() ? " (picked)" : "");
+		    ImGui::TableNextColumn();
+		    if (plan->getKernelNs(k) > 0) {
+			ImGui::Text("%4.2lf", plan->getKernelNs(k) / 1000);
+		    } else {
+			ImGui::Text("-");
+		    }
+		}
+		ImGui::EndTable();
+		ImGui::TextWrapped("Kernels without a time were given up on, or not measured at all when a single one "
+				   "supports the size.");
+	    }
+	}
+	ImGui::Separator();
+	ImGui::InputText("Wisdom File Path", wisdom_path, IM_ARRAYSIZE(wisdom_path));
+	if (ImGui::Button("Save##wisdom")) {
+	    try {
+		dctPlanSaveWisdom(wisdom_path);
+		snprintf((char*)&plan_status_msg, 512, "Wisdom saved.");
+	    } catch (const std::exception& ex) {
+		snprintf((char*)&plan_status_msg, 512, "Couldn't save the wisdom. Reason: %s", ex.what());
+	    }
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Load##wisdom")) {
+	    try {
+		size_t loaded = dctPlanLoadWisdom(wisdom_path);
+		snprintf((char*)&plan_status_msg, 512, "%zu entries loaded.", loaded);
+	    } catch (const std::exception& ex) {
+		snprintf((char*)&plan_status_msg, 512, "Couldn't load the wisdom. Reason: %s", ex.what());
+	    }
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Forget##wisdom")) {
+	    dctPlanForgetWisdom();
+	    plan_status_msg[0] = '\0';
+	}
+	ImGui::SameLine();
+	ImGui::TextWrapped("%s", plan_status_msg);
+	std::vector<DctPlanWisdom> wisdom = dctPlanGetWisdom();
+	if (!wisdom.empty() && ImGui::BeginTable("table_wisdom", 4)) {
+	    ImGui::TableNextColumn();
+	    ImGui::Text("Size");
+	    ImGui::TableNextColumn();
+	    ImGui::Text("Samples");
+	    ImGui::TableNextColumn();
+	    ImGui::Text("Threads");
+	    ImGui::TableNextColumn();
+	    ImGui::Text("Kernel");
+	    for (const DctPlanWisdom& entry : wisdom) {
+		ImGui::TableNextColumn();
+		ImGui::Text("%ux%u", entry.rows, entry.cols);
+		ImGui::TableNextColumn();
+		ImGui::Text("%s", MyDCTPrecisionName(entry.precision));
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", entry.threads);
+		ImGui::TableNextColumn();
+		ImGui::Text("%s", dctPlanKernelName(entry.kernel));
+	    }
+	    ImGui::EndTable();
+	}
+    }
+}
+
 void dctBenchWindow(bool* visible) {
     ImGui::SetNextWindowSize(ImVec2(720, 520), ImGuiCond_Once);
     ImGui::Begin(DCT_BENCH_WINDOW_TITLE, visible);
     ImGui::TextWrapped("Demo and benchmark OpenCV's cv::dct() and MyDCT");
     dctBenchWindowInteractiveDemoSection();
+    dctBenchWindowInputSection();
     dctBenchWindowBenchmarkingSection();
+    dctBenchWindowFixedKernelsSection();
+    dctBenchWindowBatchedBlocksSection();
+    dctBenchWindowThreadScalingSection();
+    dctBenchWindowPrecisionSection();
+    dctBenchWindowPlansSection();
+    dctBenchWindowMatrixIoSection();
     ImGui::End();
 }
\ No newline at end of file
@@ -36,6 +36,25 @@
 #define DCT_IMPL_CV 0
 #define DCT_IMPL_MY 1
 #define DCT_IMPL_MY_MONO 2
+#define DCT_IMPL_MY_NAIVE 3
+#define DCT_IMPL_MY_FAST 4
+#define DCT_IMPL_MY_FIXED 5
+#define DCT_IMPL_MY_SIMD 6
+#define DCT_IMPL_MY_PARALLEL 7  // On the shared thread pool
+#define DCT_IMPL_MY_TYPED 8  // MyTypedDDCT2(), with the given precision
+#define DCT_IMPL_MY_BATCH 9  // MyBatchDDCT2(), interleaved blocks
+#define DCT_IMPL_MY_BATCH_SOA 10  // MyBatchDDCT2(), SoA blocks
+#define DCT_IMPL_PLAN 11  // DctPlan, with the kernel it finds to be the fastest
+
+#define BENCH_STAT_MIN 0
+#define BENCH_STAT_MEDIAN 1
+#define BENCH_STAT_P95 2
+#define BENCH_STAT_P99 3
+#define BENCH_STAT_STDDEV 4
+#define BENCH_STAT_IPC 5     // Instructions per cycle, from the hardware counters
+#define BENCH_STAT_GFLOPS 6  // From the median, see perfNominalDctFlops()
+
+#define BENCH_ASPECT_COUNT 7
 
 #define USE_AUTO 0
 #define USE_ENGINEERING 1
@@ -0,0 +1,475 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "dct_plan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+#include "h_time.h"
+#include "my_dct_fixed.h"
+#include "thread_pool.h"
+
+#ifdef DCT_PLAN_WITH_OPENCV
+#include "opencv2/opencv.hpp"
+#endif
+
+/*
+ * Wisdom
+ *
+ * The winners of the plans measured so far, by size, precision and number of threads. The file it's saved to starts with a
+ * line holding DCT_PLAN_WISDOM_MAGIC, DCT_PLAN_WISDOM_VERSION, the instruction set detected by MyDCTSimdDetectIsa() and the
+ * number of cores, then holds one "rows cols precision threads kernel" line per entry. A file written on a machine with a
+ * different instruction set or number of cores is ignored, as its timings would say little about this one.
+ */
+
+typedef std::tuple<unsigned, unsigned, int, unsigned> DctPlanKey;  // rows, cols, precision, threads
+
+static std::mutex wisdom_mtx;
+static std::map<DctPlanKey, int> wisdom;
+
+/**
+ * @return The name of a kernel (DCT_PLAN_KERNEL_*), as the function that implements it.
+ */
+const char* dctPlanKernelName(int kernel) {
+    static const char* names[] = {"MyDDCT2Naive()", "MyDDCT2()",          "MyFastDDCT2()", "MyFixedDDCT2()", "MySimdDDCT2()",
+				  "MyBatchDDCT2()", "MyParallelDDCT2()", "cv::dct()",      "MyTypedDDCT2()"};
+    return kernel >= 0 && kernel < DCT_PLAN_KERNEL_COUNT ? names[kernel] : "?";
+}
+
+/**
+ * Tells whether a kernel can transform matrices of the given size and precision. The other precisions than double are only
+ * implemented by DCT_PLAN_KERNEL_TYPED, which also works in double precision.
+ * @param kernel The kernel (DCT_PLAN_KERNEL_*).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param precision The sample type (MYDCT_PRECISION_*).
+ */
+bool dctPlanSupports(int kernel, unsigned rows, unsigned cols, int precision) {
+    if (precision != MYDCT_PRECISION_DOUBLE) return kernel == DCT_PLAN_KERNEL_TYPED;
+    switch (kernel) {
+	case DCT_PLAN_KERNEL_BATCH:
+	    return rows == cols;
+	case DCT_PLAN_KERNEL_FIXED:
+	    return rows == cols && MyFixedDCTSupports(rows);
+	case DCT_PLAN_KERNEL_CV:
+#ifdef DCT_PLAN_WITH_OPENCV
+	    return rows % 2 == 0 && cols % 2 == 0;
+#else
+	    return false;  // Not built in
+#endif
+	case DCT_PLAN_KERNEL_NAIVE:
+	case DCT_PLAN_KERNEL_TABLE:
+	case DCT_PLAN_KERNEL_FAST:
+	case DCT_PLAN_KERNEL_SIMD:
+	case DCT_PLAN_KERNEL_PARALLEL:
+	case DCT_PLAN_KERNEL_TYPED:
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+/**
+ * Leaves out of the measurements the kernels that can't win: the naive one past a modest size (it's a hundred times slower
+ * than the others and would make planning take seconds), the batched one for wide blocks, and the parallel one when there's
+ * a single thread or the matrix is too small for it to use them.
+ */
+static bool dctPlanWorthMeasuring(int kernel, unsigned rows, unsigned cols, unsigned threads) {
+    switch (kernel) {
+	case DCT_PLAN_KERNEL_NAIVE:
+	    return std::max(rows, cols) <= DCT_PLAN_NAIVE_MAX_WIDTH;
+	case DCT_PLAN_KERNEL_BATCH:
+	    return rows <= DCT_PLAN_BATCH_MAX_WIDTH;
+	case DCT_PLAN_KERNEL_PARALLEL:
+	    return threads > 1 && static_cast<size_t>(rows) * cols >= MYDCT_PARALLEL_MIN_ELEMS;
+	default:
+	    return true;
+    }
+}
+
+/**
+ * @return A copy of the wisdom, sorted by size, precision and number of threads.
+ */
+std::vector<DctPlanWisdom> dctPlanGetWisdom() {
+    std::lock_guard<std::mutex> lock(wisdom_mtx);
+    std::vector<DctPlanWisdom> entries;
+    for (const auto& entry : wisdom) {
+	entries.push_back({std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first),
+			   std::get<3>(entry.first), entry.second});
+    }
+    return entries;
+}
+
+/**
+ * Empties the wisdom, so that the next plans are measured again. Plans that already exist keep their kernel.
+ */
+void dctPlanForgetWisdom() {
+    std::lock_guard<std::mutex> lock(wisdom_mtx);
+    wisdom.clear();
+}
+
+/**
+ * Adds the contents of a wisdom file to the wisdom, replacing the entries it already had for the same plans.
+ * @param path The path of the file.
+ * @return The number of entries read: 0 if the file doesn't exist or has been written on a different machine.
+ * @throws std::runtime_error If the file isn't a wisdom file or is corrupted.
+ */
+size_t dctPlanLoadWisdom(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) return 0;  // No wisdom yet
+    char magic[8];
+    int version, isa;
+    unsigned cores;
+    if (fscanf(file, "%7s %d %d %u", magic, &version, &isa, &cores) != 4 || strcmp(magic, DCT_PLAN_WISDOM_MAGIC) != 0) {
+	fclose(file);
+	throw std::runtime_error("Not a wisdom file.");
+    }
+    if (version != DCT_PLAN_WISDOM_VERSION || isa != MyDCTSimdDetectIsa() || cores != ThreadPool::getDefaultThreadCount()) {
+	fclose(file);
+	return 0;
+    }
+    std::vector<DctPlanWisdom> entries;
+    DctPlanWisdom entry;
+    int fields;
+    bool ok = true;
+    while (ok && (fields = fscanf(file, "%u %u %d %u %d", &entry.rows, &entry.cols, &entry.precision, &entry.threads,
+				  &entry.kernel)) == 5) {
+	// The plans that picked cv::dct() are skipped by the builds without it, as they can share the file with the ones with it
+	bool supported = dctPlanSupports(entry.kernel, entry.rows, entry.cols, entry.precision);
+	ok = entry.rows > 0 && entry.cols > 0 && entry.threads > 0 && (supported || entry.kernel == DCT_PLAN_KERNEL_CV);
+	if (supported) entries.push_back(entry);
+    }
+    ok = ok && fields == EOF && !ferror(file);
+    fclose(file);
+    if (!ok) throw std::runtime_error("The wisdom file is corrupted.");
+    std::lock_guard<std::mutex> lock(wisdom_mtx);
+    for (const DctPlanWisdom& e : entries) wisdom[DctPlanKey(e.rows, e.cols, e.precision, e.threads)] = e.kernel;
+    return entries.size();
+}
+
+/**
+ * Writes the wisdom to a file, for dctPlanLoadWisdom() to read back.
+ * @param path The path of the file.
+ * @throws std::runtime_error If the file can't be written.
+ */
+void dctPlanSaveWisdom(const std::string& path) {
+    std::vector<DctPlanWisdom> entries = dctPlanGetWisdom();
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    bool ok = fprintf(file, "%s %d %d %u\n", DCT_PLAN_WISDOM_MAGIC, DCT_PLAN_WISDOM_VERSION, MyDCTSimdDetectIsa(),
+		      ThreadPool::getDefaultThreadCount()) > 0;
+    for (const DctPlanWisdom& e : entries)
+	ok = ok && fprintf(file, "%u %u %d %u %d\n", e.rows, e.cols, e.precision, e.threads, e.kernel) > 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) throw std::runtime_error("An I/O error occurred while writing the file.");
+}
+
+/**
+ * Creates a plan, measuring the kernels unless the wisdom already knows the winner (or a kernel is given).
+ * @param rows The height of the matrices.
+ * @param cols The width of the matrices.
+ * @param precision The sample type (MYDCT_PRECISION_*); the matrices are still handed over as doubles.
+ * @param threads The number of threads the plan is for, or 0 for the size of the shared thread pool. Only
+ * DCT_PLAN_KERNEL_PARALLEL uses more than one (those of the shared pool): callers that already run on the pool should ask for
+ * one.
+ * @param kernel The kernel to use (DCT_PLAN_KERNEL_*), or DCT_PLAN_KERNEL_AUTO to pick the fastest.
+ * @throws std::invalid_argument If the matrices are empty, the precision is unknown or the kernel doesn't support them.
+ */
+DctPlan::DctPlan(unsigned rows, unsigned cols, int precision, unsigned threads, int kernel)
+    : rows(rows), cols(cols), precision(precision), threads(threads), kernel(kernel), from_wisdom(false), kernel_ns() {
+    if (rows == 0 || cols == 0) throw std::invalid_argument("Can't plan the transform of an empty matrix.");
+    if (precision < MYDCT_PRECISION_DOUBLE || precision > MYDCT_PRECISION_FIXED16)
+	throw std::invalid_argument("Unsupported precision.");
+    if (this->threads == 0) this->threads = getSharedThreadPool().getThreadCount();
+    if (kernel != DCT_PLAN_KERNEL_AUTO) {
+	if (!dctPlanSupports(kernel, rows, cols, precision))
+	    throw std::invalid_argument("The kernel doesn't support the given size or precision.");
+	return;
+    }
+    DctPlanKey key(rows, cols, precision, this->threads);
+    {
+	std::lock_guard<std::mutex> lock(wisdom_mtx);
+	auto it = wisdom.find(key);
+	if (it != wisdom.end()) {
+	    this->kernel = it->second;
+	    from_wisdom = true;
+	    return;
+	}
+    }
+    measure();  // Without holding the lock, two threads may measure the same plan: the last one wins
+    std::lock_guard<std::mutex> lock(wisdom_mtx);
+    wisdom[key] = this->kernel;
+}
+
+/**
+ * Times every kernel that is worth it on a batch of random matrices (as many as it takes to reach DCT_PLAN_MEASURE_ELEMS
+ * elements) and keeps the fastest. Each kernel is run once untimed, then DCT_PLAN_MEASURE_RUNS times; the kernels that are
+ * likely to be the fastest go first, so that the others can be given up on after a single run.
+ */
+void DctPlan::measure() {
+    static const int order[] = {DCT_PLAN_KERNEL_FIXED, DCT_PLAN_KERNEL_BATCH, DCT_PLAN_KERNEL_SIMD,
+				DCT_PLAN_KERNEL_FAST,  DCT_PLAN_KERNEL_CV,    DCT_PLAN_KERNEL_PARALLEL,
+				DCT_PLAN_KERNEL_TYPED, DCT_PLAN_KERNEL_TABLE, DCT_PLAN_KERNEL_NAIVE};
+    std::vector<int> candidates;
+    for (int k : order) {
+	if (dctPlanSupports(k, rows, cols, precision) && dctPlanWorthMeasuring(k, rows, cols, threads)) candidates.push_back(k);
+    }
+    kernel = candidates.front();  // DCT_PLAN_KERNEL_TYPED is always there
+    if (candidates.size() == 1) return;
+    size_t area = static_cast<size_t>(rows) * cols;
+    size_t blocks = std::max<size_t>(1, DCT_PLAN_MEASURE_ELEMS / area);
+    std::vector<double> in(area * blocks), out(area * blocks);
+    uint64_t state = 1;
+    for (double& v : in) {  // In [-999, 1000), like genRndMat(), which the headless tools don't link
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	v = static_cast<double>(state >> 11) / 9007199254740992.0 * 1999.0 - 999.0;
+    }
+    MyDCTWorkspace ws;
+    timespec_t ts;
+    double best = std::numeric_limits<double>::infinity();
+    for (int k : candidates) {
+	nsec_t t0 = HTime_GetNsDelta(&ts);
+	runBlocks(&in.front(), &out.front(), blocks, false, &ws, k);  // Builds the tables and warms the caches up
+	double k_best = static_cast<double>(HTime_GetNsDelta(&ts) - t0) / blocks;
+	if (k_best <= best * DCT_PLAN_GIVE_UP_RATIO) {  // Otherwise not even close, cold as it was
+	    for (int r = 0; r < DCT_PLAN_MEASURE_RUNS; r++) {
+		t0 = HTime_GetNsDelta(&ts);
+		runBlocks(&in.front(), &out.front(), blocks, false, &ws, k);
+		k_best = std::min(k_best, static_cast<double>(HTime_GetNsDelta(&ts) - t0) / blocks);
+		if (k_best > best * DCT_PLAN_GIVE_UP_RATIO) break;
+	    }
+	}
+	kernel_ns[k] = std::max(k_best, 1e-3);  // 0 means "not measured"
+	if (k_best < best) {
+	    best = k_best;
+	    kernel = k;
+	}
+    }
+}
+
+/**
+ * DCT_PLAN_KERNEL_TYPED: converts the matrix to the sample type (with as many fractional bits as the largest input allows),
+ * transforms it and converts it back.
+ */
+template <typename T>
+static void dctPlanRunTyped(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows,
+			    unsigned cols, bool inverse) {
+    static thread_local MyTypedDCTWorkspace<T> ws;
+    static thread_local std::vector<T> buf;
+    buf.resize(static_cast<size_t>(rows) * cols);
+    double max_abs = 0;
+    for (unsigned r = 0; r < rows; r++) {
+	for (unsigned c = 0; c < cols; c++) max_abs = std::max(max_abs, std::fabs(in[r * in_stride + c]));
+    }
+    int frac_bits = MyTypedDCTFracBits<T>(max_abs, rows, cols);
+    for (unsigned r = 0; r < rows; r++) {
+	for (unsigned c = 0; c < cols; c++) buf[r * cols + c] = MyDCTSample<T>::fromDouble(in[r * in_stride + c], frac_bits);
+    }
+    if (inverse) {
+	MyTypedDIDCT2(&buf.front(), cols, &buf.front(), cols, rows, cols, ws);
+    } else {
+	MyTypedDDCT2(&buf.front(), cols, &buf.front(), cols, rows, cols, ws);
+    }
+    for (unsigned r = 0; r < rows; r++) {
+	for (unsigned c = 0; c < cols; c++) out[r * out_stride + c] = MyDCTSample<T>::toDouble(buf[r * cols + c], frac_bits);
+    }
+}
+
+/**
+ * Transforms a single matrix with the given kernel.
+ */
+void DctPlan::run(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, bool inverse,
+		  MyDCTWorkspace* ws, int m_kernel) const {
+    switch (m_kernel) {
+	case DCT_PLAN_KERNEL_NAIVE:
+	    if (inverse) {  // There's no naive inverse
+		MyDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    } else {
+		std::vector<double> tile(static_cast<size_t>(rows) * cols);
+		for (unsigned r = 0; r < rows; r++) std::copy(in + r * in_stride, in + r * in_stride + cols, &tile[r * cols]);
+		tile = MyDDCT2Naive(tile, rows, cols);
+		for (unsigned r = 0; r < rows; r++) std::copy(&tile[r * cols], &tile[r * cols] + cols, out + r * out_stride);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_TABLE:
+	    if (inverse) {
+		MyDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    } else {
+		MyDDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_FAST:
+	    if (inverse) {
+		MyFastDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    } else {
+		MyFastDDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_FIXED:
+	    if (inverse) {
+		MyFixedDIDCT2(in, in_stride, out, out_stride, rows);
+	    } else {
+		MyFixedDDCT2(in, in_stride, out, out_stride, rows);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_BATCH:
+	    if (in_stride != cols || out_stride != cols) {  // A lone block with strides is what the SIMD kernel computes anyway
+		run(in, in_stride, out, out_stride, inverse, ws, DCT_PLAN_KERNEL_SIMD);
+	    } else if (inverse) {
+		MyBatchDIDCT2(in, out, rows, 1, MYDCT_LAYOUT_INTERLEAVED, ws);
+	    } else {
+		MyBatchDDCT2(in, out, rows, 1, MYDCT_LAYOUT_INTERLEAVED, ws);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_SIMD:
+	    if (inverse) {
+		MySimdDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    } else {
+		MySimdDDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	    }
+	    break;
+	case DCT_PLAN_KERNEL_PARALLEL:
+	    if (inverse) {
+		MyParallelDIDCT2(in, in_stride, out, out_stride, rows, cols, nullptr, ws);
+	    } else {
+		MyParallelDDCT2(in, in_stride, out, out_stride, rows, cols, nullptr, ws);
+	    }
+	    break;
+#ifdef DCT_PLAN_WITH_OPENCV
+	case DCT_PLAN_KERNEL_CV: {
+	    cv::Mat mat_in = cv::Mat(rows, cols, CV_64F, const_cast<double*>(in), in_stride * sizeof(double));
+	    cv::Mat mat_out = cv::Mat(rows, cols, CV_64F, out, out_stride * sizeof(double));
+	    if (inverse) {
+		cv::idct(mat_in, mat_out);
+	    } else {
+		cv::dct(mat_in, mat_out);
+	    }
+	    break;
+	}
+#endif
+	default:  // DCT_PLAN_KERNEL_TYPED
+	    switch (precision) {
+		case MYDCT_PRECISION_FLOAT:
+		    dctPlanRunTyped<float>(in, in_stride, out, out_stride, rows, cols, inverse);
+		    break;
+		case MYDCT_PRECISION_FIXED32:
+		    dctPlanRunTyped<int32_t>(in, in_stride, out, out_stride, rows, cols, inverse);
+		    break;
+		case MYDCT_PRECISION_FIXED16:
+		    dctPlanRunTyped<int16_t>(in, in_stride, out, out_stride, rows, cols, inverse);
+		    break;
+		default:
+		    dctPlanRunTyped<double>(in, in_stride, out, out_stride, rows, cols, inverse);
+	    }
+    }
+}
+
+/**
+ * Transforms contiguous matrices with the given kernel: all at once for the batched one, one at a time for the others.
+ */
+void DctPlan::runBlocks(const double* in, double* out, size_t blocks, bool inverse, MyDCTWorkspace* ws, int m_kernel) const {
+    if (m_kernel == DCT_PLAN_KERNEL_BATCH) {
+	if (inverse) {
+	    MyBatchDIDCT2(in, out, rows, blocks, MYDCT_LAYOUT_INTERLEAVED, ws);
+	} else {
+	    MyBatchDDCT2(in, out, rows, blocks, MYDCT_LAYOUT_INTERLEAVED, ws);
+	}
+	return;
+    }
+    size_t area = static_cast<size_t>(rows) * cols;
+    for (size_t b = 0; b < blocks; b++) run(in + b * area, cols, out + b * area, cols, inverse, ws, m_kernel);
+}
+
+/**
+ * Computes the 2-D DCT-II of a matrix with the plan's kernel.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void DctPlan::forward(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, MyDCTWorkspace* ws) const {
+    run(in, in_stride, out, out_stride, false, ws, kernel);
+}
+
+/**
+ * Computes the 2-D DCT-III (inverse DCT-II) of a matrix with the plan's kernel, with the same parameters as forward().
+ */
+void DctPlan::inverse(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, MyDCTWorkspace* ws) const {
+    run(in, in_stride, out, out_stride, true, ws, kernel);
+}
+
+/**
+ * Computes the 2-D DCT-II of many matrices of the plan's size, stored one after the other.
+ * @param in The input matrices.
+ * @param out The output matrices (may be the same as the input).
+ * @param blocks The number of matrices.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void DctPlan::forwardBlocks(const double* in, double* out, size_t blocks, MyDCTWorkspace* ws) const {
+    runBlocks(in, out, blocks, false, ws, kernel);
+}
+
+/**
+ * Inverse of forwardBlocks(), with the same parameters.
+ */
+void DctPlan::inverseBlocks(const double* in, double* out, size_t blocks, MyDCTWorkspace* ws) const {
+    runBlocks(in, out, blocks, true, ws, kernel);
+}
+
+/**
+ * Vector-based front end for forward().
+ * @param in The input vector (a rows*cols matrix).
+ * @return A vector containing the DCT of the input.
+ * @throws std::invalid_argument If the size of the vector doesn't match the plan.
+ */
+std::vector<double> DctPlan::forward(const std::vector<double>& in) const {
+    if (in.size() != static_cast<size_t>(rows) * cols)
+	throw std::invalid_argument("The size of the matrix doesn't match the one of the plan.");
+    std::vector<double> out(in.size());
+    forward(&in.front(), cols, &out.front(), cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for inverse().
+ * @param in The input vector (a rows*cols matrix).
+ * @return A vector containing the inverse DCT of the input.
+ * @throws std::invalid_argument If the size of the vector doesn't match the plan.
+ */
+std::vector<double> DctPlan::inverse(const std::vector<double>& in) const {
+    if (in.size() != static_cast<size_t>(rows) * cols)
+	throw std::invalid_argument("The size of the matrix doesn't match the one of the plan.");
+    std::vector<double> out(in.size());
+    inverse(&in.front(), cols, &out.front(), cols);
+    return out;
+}
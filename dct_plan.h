@@ -0,0 +1,117 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_DCT_PLAN_H
+#define PROJ2_DCT_PLAN_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "my_dct.h"
+#include "my_dct_typed.h"
+
+// The kernels a plan can pick from
+#define DCT_PLAN_KERNEL_NAIVE 0     // MyDDCT2Naive() (the inverse runs MyDIDCT2())
+#define DCT_PLAN_KERNEL_TABLE 1     // MyDDCT2()
+#define DCT_PLAN_KERNEL_FAST 2      // MyFastDDCT2()
+#define DCT_PLAN_KERNEL_FIXED 3     // MyFixedDDCT2(), for the square sizes that satisfy MyFixedDCTSupports()
+#define DCT_PLAN_KERNEL_SIMD 4      // MySimdDDCT2()
+#define DCT_PLAN_KERNEL_BATCH 5     // MyBatchDDCT2(), square matrices only
+#define DCT_PLAN_KERNEL_PARALLEL 6  // MyParallelDDCT2(), on the shared thread pool
+#define DCT_PLAN_KERNEL_CV 7        // cv::dct(), even sizes only, in the builds with DCT_PLAN_WITH_OPENCV defined
+#define DCT_PLAN_KERNEL_TYPED 8     // MyTypedDDCT2(), the only one for the precisions other than double
+#define DCT_PLAN_KERNEL_COUNT 9
+#define DCT_PLAN_KERNEL_AUTO -1  // Measure them (or look the winner up in the wisdom)
+
+#define DCT_PLAN_MEASURE_ELEMS (1u << 14)  // Small matrices are timed in batches of about this many elements (128 kB)
+#define DCT_PLAN_MEASURE_RUNS 3            // Timed runs per kernel, after an untimed one
+#define DCT_PLAN_GIVE_UP_RATIO 2.0         // A kernel whose first run is this much slower than the best isn't run again
+#define DCT_PLAN_NAIVE_MAX_WIDTH 32u       // Wider naive transforms aren't worth measuring
+#define DCT_PLAN_BATCH_MAX_WIDTH 32u       // The batched transform needs 32 blocks worth of scratch memory
+
+#define DCT_PLAN_WISDOM_MAGIC "DCTW"
+#define DCT_PLAN_WISDOM_VERSION 1
+#define DCT_PLAN_WISDOM_FILE "./dct_wisdom.txt"
+
+/**
+ * A 2-D DCT of a given size, precision and number of threads, bound to the kernel that computes it fastest on this machine.
+ * The first plan for a given (rows, cols, precision, threads) times every kernel that supports it (see dctPlanSupports())
+ * and remembers the winner in a process-wide table, the wisdom, which later plans look up instead: a plan is then as cheap
+ * to create as a table lookup. The wisdom can be saved to a file and loaded back by the next run (see dctPlanSaveWisdom()).
+ * A plan can also be bound to a given kernel, which is how the callers that let the user pick one go through plans too.
+ * Plans are immutable, so a single one can be used by several threads at once, each with its own workspace. The forward and
+ * the inverse transforms use the same kernel, picked by timing the forward one.
+ */
+class DctPlan {
+   private:
+    unsigned rows, cols;
+    int precision;
+    unsigned threads;
+    int kernel;
+    bool from_wisdom;
+    double kernel_ns[DCT_PLAN_KERNEL_COUNT];  // Per matrix, 0 for the kernels that haven't been measured
+
+    void measure();
+    void run(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, bool inverse, MyDCTWorkspace* ws,
+	     int m_kernel) const;
+    void runBlocks(const double* in, double* out, size_t blocks, bool inverse, MyDCTWorkspace* ws, int m_kernel) const;
+
+   public:
+    DctPlan(unsigned rows, unsigned cols, int precision = MYDCT_PRECISION_DOUBLE, unsigned threads = 0,
+	    int kernel = DCT_PLAN_KERNEL_AUTO);
+
+    unsigned getRows() const { return rows; }
+    unsigned getCols() const { return cols; }
+    int getPrecision() const { return precision; }
+    unsigned getThreads() const { return threads; }
+    int getKernel() const { return kernel; }
+    bool isFromWisdom() const { return from_wisdom; }
+    double getKernelNs(int m_kernel) const { return kernel_ns[m_kernel]; }
+
+    void forward(const double*, ptrdiff_t, double*, ptrdiff_t, MyDCTWorkspace* = nullptr) const;
+    void inverse(const double*, ptrdiff_t, double*, ptrdiff_t, MyDCTWorkspace* = nullptr) const;
+    void forwardBlocks(const double*, double*, size_t, MyDCTWorkspace* = nullptr) const;
+    void inverseBlocks(const double*, double*, size_t, MyDCTWorkspace* = nullptr) const;
+    std::vector<double> forward(const std::vector<double>&) const;
+    std::vector<double> inverse(const std::vector<double>&) const;
+};
+
+/**
+ * An entry of the wisdom: the kernel that won for a given size, precision and number of threads.
+ */
+struct DctPlanWisdom {
+    unsigned rows, cols;
+    int precision;
+    unsigned threads;
+    int kernel;
+};
+
+const char* dctPlanKernelName(int);
+bool dctPlanSupports(int, unsigned, unsigned, int);
+std::vector<DctPlanWisdom> dctPlanGetWisdom();
+void dctPlanForgetWisdom();
+size_t dctPlanLoadWisdom(const std::string&);
+void dctPlanSaveWisdom(const std::string&);
+
+#endif  // PROJ2_DCT_PLAN_H
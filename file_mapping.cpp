@@ -0,0 +1,80 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "file_mapping.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+/**
+ * Maps a file. The descriptor is closed right away, the mapping stays valid without it. An empty file can't be mapped,
+ * so getBytes() returns nullptr for it.
+ * @param path The path of the file.
+ * @throws std::runtime_error If the file can't be opened or mapped.
+ */
+FileMapping::FileMapping(const std::string& path) : base(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Unable to open the specified file.");
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok && info.st_size > 0) {
+	length = static_cast<size_t>(info.st_size);
+	void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	ok = mapped != MAP_FAILED;
+	if (ok) base = mapped;
+    }
+    close(fd);
+    if (!ok) throw std::runtime_error("Unable to map the specified file.");
+}
+
+FileMapping::~FileMapping() {
+    unmap();
+}
+
+/**
+ * Tells the kernel that the whole file will be read soon, in no particular order (e.g. when it's used in place).
+ */
+void FileMapping::adviseWillNeed() const {
+    if (base != nullptr) madvise(base, length, MADV_WILLNEED);
+}
+
+/**
+ * Tells the kernel that the file will be read once from start to end (e.g. when it's converted), so that it can read
+ * ahead more and drop the pages behind.
+ */
+void FileMapping::adviseSequential() const {
+    if (base != nullptr) madvise(base, length, MADV_SEQUENTIAL);
+}
+
+/**
+ * Releases the mapping early, once its contents have been copied. getBytes() returns nullptr afterwards.
+ */
+void FileMapping::unmap() {
+    if (base != nullptr) munmap(base, length);
+    base = nullptr;
+}
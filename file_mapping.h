@@ -0,0 +1,52 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_FILE_MAPPING_H
+#define PROJ2_FILE_MAPPING_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A whole file mapped read-only in memory, for as long as the object exists or until unmap() is called. An empty file is
+ * an empty mapping. BmpMapping, MatFileMapping and the CSV parser read their files through it.
+ */
+class FileMapping {
+   private:
+    void* base;  // nullptr if there's nothing mapped
+    size_t length;
+
+   public:
+    explicit FileMapping(const std::string& path);
+    ~FileMapping();
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    const unsigned char* getBytes() const { return static_cast<const unsigned char*>(base); }
+    size_t getLength() const { return length; }
+    void adviseWillNeed() const;
+    void adviseSequential() const;
+    void unmap();
+};
+
+#endif  // PROJ2_FILE_MAPPING_H
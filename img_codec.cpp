@@ -0,0 +1,1057 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "img_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "thread_pool.h"
+
+/**
+ * Makes the plan the chunks are transformed with: COMPRESSOR_BACKEND_AUTO lets it pick the fastest kernel for the chunk size
+ * (see dct_plan.cpp), the other backends bind it to their own kernel. The plans are for a single thread, as the codec
+ * already spreads the bands across the shared thread pool.
+ * @param backend The requested backend.
+ * @param chunk_width The width of the chunks.
+ * @return The plan.
+ * @throws std::invalid_argument If the backend is unknown or doesn't support the chunk size.
+ */
+std::shared_ptr<const DctPlan> codecPlan(int backend, int chunk_width) {
+    static const int kernels[] = {DCT_PLAN_KERNEL_CV,   DCT_PLAN_KERNEL_TABLE, DCT_PLAN_KERNEL_FAST,
+				  DCT_PLAN_KERNEL_FIXED, DCT_PLAN_KERNEL_AUTO,  DCT_PLAN_KERNEL_BATCH};  // By COMPRESSOR_BACKEND_*
+    if (backend < COMPRESSOR_BACKEND_CV || backend > COMPRESSOR_BACKEND_MY_BATCH) throw std::invalid_argument("Unknown backend.");
+    return std::make_shared<DctPlan>(chunk_width, chunk_width, MYDCT_PRECISION_DOUBLE, 1, kernels[backend]);
+}
+
+/**
+ * Converts the pixels of a chunk to doubles.
+ * @param chunk The chunk.
+ * @param tile The contiguous width*width matrix that will hold the result.
+ */
+void loadChunk(const ChunkView& chunk, double* tile) {
+    for (int row = 0; row < chunk.width; row++) {
+	const unsigned char* src = chunk.origin + row * chunk.stride;
+	double* dst = tile + row * chunk.width;
+	for (int col = 0; col < chunk.width; col++) dst[col] = static_cast<double>(src[col]);
+    }
+}
+
+/**
+ * Rounds (half away from zero, like round()) and clamps a row of pixels to the [0, 255] range, then stores them as bytes.
+ * @param src The values to store.
+ * @param dst The destination pixels.
+ * @param n The number of pixels.
+ */
+void storePixels(const double* src, unsigned char* dst, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    // Clamping first makes the truncation safe; the fractional part then tells whether to round up. Eight pixels at a time,
+    // narrowed to bytes by the saturating packs.
+    const __m128d lower = _mm_setzero_pd(), upper = _mm_set1_pd(255.0), half = _mm_set1_pd(.5);
+    for (; i + 8 <= n; i += 8) {
+	__m128i quad[2];
+	for (int q = 0; q < 2; q++) {
+	    __m128d lo = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(src + i + 4 * q), lower), upper);
+	    __m128d hi = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(src + i + 4 * q + 2), lower), upper);
+	    __m128i int_lo = _mm_cvttpd_epi32(lo), int_hi = _mm_cvttpd_epi32(hi);
+	    __m128d up_lo = _mm_cmpge_pd(_mm_sub_pd(lo, _mm_cvtepi32_pd(int_lo)), half);
+	    __m128d up_hi = _mm_cmpge_pd(_mm_sub_pd(hi, _mm_cvtepi32_pd(int_hi)), half);
+	    __m128i up = _mm_castps_si128(
+		_mm_shuffle_ps(_mm_castpd_ps(up_lo), _mm_castpd_ps(up_hi), _MM_SHUFFLE(2, 0, 2, 0)));
+	    quad[q] = _mm_sub_epi32(_mm_unpacklo_epi64(int_lo, int_hi), up);  // The mask is -1 where rounding up
+	}
+	__m128i words = _mm_packs_epi32(quad[0], quad[1]);
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+    }
+#endif
+    for (; i < n; i++) {
+	double tmp = round(src[i]);
+	if (tmp < .0f) {
+	    tmp = .0f;
+	} else if (tmp > 255.0f) {
+	    tmp = 255.0f;
+	}
+	dst[i] = static_cast<unsigned char>(tmp);
+    }
+}
+
+/*
+ * A JPEG-like codec for grayscale images.
+ *
+ * The image is split in chunk_width*chunk_width chunks, each of which is transformed, cut along the diagonal (as the preview
+ * compressor always did), quantized with a JPEG-style table stretched to the size of the chunk, and scanned in zig-zag order.
+ * The scan is turned into symbols the way baseline JPEG does: the DC coefficient is coded as the difference from the previous
+ * chunk's, the AC ones as (zero run, magnitude category) pairs plus the magnitude bits, with ZRL and EOB for long runs and
+ * trailing zeros. The symbols of the whole image are counted first, so that the two Huffman tables (DC and AC) are optimal
+ * for it.
+ *
+ * Every row of chunks (a band) starts its own DC prediction and is coded in its own byte-aligned segment, whose length is
+ * stored in the header: the bands are then encoded and decoded independently, in parallel.
+ *
+ * Container layout (little endian):
+ *   "DCTC" | version (u8) | quality (u8) | chunk_width (u16) | diag_cut (u16) | width (u32) | height (u32)
+ *   DC table, AC table: code counts for the lengths 1 to 16 (16 * u8), then the symbols by increasing length (u8 each)
+ *   band sizes (u32 for each band)
+ *   band segments
+ * The quantization table is not stored, since it only depends on the quality and the chunk width.
+ */
+
+// Luminance quantization table from the JPEG standard (ITU T.81, Annex K), for 8x8 chunks
+static const unsigned char codec_base_quant[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,  14, 13, 16, 24, 40,  57,  69,  56,
+    14, 17, 22, 29, 51,  87,  80,  62,  18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+
+/**
+ * Builds the quantization table for the given chunk size and quality. The JPEG table is scaled with the quality like libjpeg
+ * does, then stretched over the chunk (each entry covers the same fraction of the spectrum it covers in a 8x8 chunk) and
+ * multiplied by chunk_width/8, since the coefficients of the orthonormal DCT grow linearly with the size of the chunk.
+ * @param chunk_width The width of the chunks.
+ * @param quality The quality, from 1 (smallest output) to 100 (every step is chunk_width/8, or 1).
+ * @param table Filled with the chunk_width*chunk_width quantization steps.
+ */
+void codecQuantTable(int chunk_width, int quality, std::vector<double>& table) {
+    quality = std::min(100, std::max(1, quality));
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    table.resize(chunk_width * chunk_width);
+    for (int v = 0; v < chunk_width; v++) {
+	for (int u = 0; u < chunk_width; u++) {
+	    int base = codec_base_quant[(v * 8 / chunk_width) * 8 + u * 8 / chunk_width];
+	    int step = std::min(255, std::max(1, (base * scale + 50) / 100));
+	    table[v * chunk_width + u] = std::max(1.0, step * chunk_width / 8.0);
+	}
+    }
+}
+
+static std::mutex zigzag_cache_mtx;
+static std::map<int, std::vector<unsigned>> zigzag_cache;
+
+/**
+ * @param chunk_width The width of the chunks.
+ * @return The zig-zag scan of a chunk_width*chunk_width chunk: the k-th element is the (row-major) index of the k-th
+ * coefficient to visit.
+ */
+const std::vector<unsigned>& codecZigZag(int chunk_width) {
+    std::lock_guard<std::mutex> lock(zigzag_cache_mtx);
+    std::vector<unsigned>& order = zigzag_cache[chunk_width];  // Map nodes don't move, the reference stays valid
+    if (order.empty()) {
+	for (int diag = 0; diag <= 2 * chunk_width - 2; diag++) {
+	    int first = std::max(0, diag - chunk_width + 1), last = std::min(diag, chunk_width - 1);
+	    for (int i = 0; i <= last - first; i++) {
+		int row = diag % 2 == 0 ? last - i : first + i;  // Even diagonals go up, odd ones go down
+		order.push_back(static_cast<unsigned>(row * chunk_width + diag - row));
+	    }
+	}
+    }
+    return order;
+}
+
+/**
+ * A canonical Huffman table, with what's needed to both encode and decode.
+ */
+struct CodecHuffTable {
+    unsigned char bits[CODEC_HUFF_MAX_BITS + 1];  // bits[l] is the number of codes of length l
+    std::vector<unsigned char> values;            // The symbols, by increasing code length
+    unsigned short code[256];
+    unsigned char length[256];                    // 0 for the symbols that don't appear
+    unsigned short lookup[1 << CODEC_HUFF_LOOKUP_BITS];  // (length << 8 | symbol) by the first bits, 0 for longer codes
+    int max_code[CODEC_HUFF_MAX_BITS + 1], min_code[CODEC_HUFF_MAX_BITS + 1], first_value[CODEC_HUFF_MAX_BITS + 1];
+};
+
+/**
+ * Computes the code tables from bits and values.
+ * @throws std::runtime_error If the counts don't describe a valid prefix code.
+ */
+static void codecHuffPrepare(CodecHuffTable& table) {
+    std::memset(table.length, 0, sizeof(table.length));
+    std::memset(table.lookup, 0, sizeof(table.lookup));
+    unsigned code = 0, k = 0;
+    for (int len = 1; len <= CODEC_HUFF_MAX_BITS; len++) {
+	if (code + table.bits[len] > (1u << len)) throw std::runtime_error("Invalid Huffman table.");
+	table.first_value[len] = static_cast<int>(k);
+	table.min_code[len] = static_cast<int>(code);
+	for (int i = 0; i < table.bits[len]; i++, k++, code++) {
+	    unsigned char symbol = table.values[k];
+	    table.code[symbol] = static_cast<unsigned short>(code);
+	    table.length[symbol] = static_cast<unsigned char>(len);
+	    if (len <= CODEC_HUFF_LOOKUP_BITS) {
+		unsigned shift = CODEC_HUFF_LOOKUP_BITS - len;
+		for (unsigned fill = 0; fill < (1u << shift); fill++) {
+		    table.lookup[(code << shift) | fill] = static_cast<unsigned short>(len << 8 | symbol);
+		}
+	    }
+	}
+	table.max_code[len] = table.bits[len] ? static_cast<int>(code) - 1 : -1;
+	code <<= 1;
+    }
+}
+
+/**
+ * Builds the optimal table for the given symbol frequencies, with codes no longer than CODEC_HUFF_MAX_BITS and no code made
+ * of ones only (the procedure from the JPEG standard, Annex K.2).
+ * @param freq The frequency of each of the 256 symbols.
+ * @param table Filled with the table.
+ */
+static void codecHuffBuild(const unsigned long* freq, CodecHuffTable& table) {
+    unsigned long count[257];
+    int code_size[257], others[257];
+    std::copy(freq, freq + 256, count);
+    count[256] = 1;  // Reserved, so that no real code is all ones
+    std::fill(code_size, code_size + 257, 0);
+    std::fill(others, others + 257, -1);
+    for (;;) {
+	int c1 = -1, c2 = -1;  // The two least frequent trees (ties go to the highest symbol)
+	for (int i = 0; i < 257; i++) {
+	    if (count[i] == 0) continue;
+	    if (c1 < 0 || count[i] <= count[c1]) {
+		c2 = c1;
+		c1 = i;
+	    } else if (c2 < 0 || count[i] <= count[c2]) {
+		c2 = i;
+	    }
+	}
+	if (c2 < 0) break;
+	count[c1] += count[c2];
+	count[c2] = 0;
+	code_size[c1]++;
+	while (others[c1] >= 0) code_size[c1 = others[c1]]++;
+	others[c1] = c2;
+	code_size[c2]++;
+	while (others[c2] >= 0) code_size[c2 = others[c2]]++;
+    }
+    int bits[257] = {0};
+    for (int i = 0; i < 257; i++) {
+	if (code_size[i] > 0) bits[code_size[i]]++;
+    }
+    for (int len = 256; len > CODEC_HUFF_MAX_BITS; len--) {  // Move the longest codes up the tree
+	while (bits[len] > 0) {
+	    int j = len - 2;
+	    while (bits[j] == 0) j--;
+	    bits[len] -= 2;
+	    bits[len - 1]++;
+	    bits[j + 1] += 2;
+	    bits[j]--;
+	}
+    }
+    int longest = CODEC_HUFF_MAX_BITS;
+    while (longest > 0 && bits[longest] == 0) longest--;
+    if (longest > 0) bits[longest]--;  // Drop the reserved symbol
+    for (int len = 0; len <= CODEC_HUFF_MAX_BITS; len++) table.bits[len] = static_cast<unsigned char>(bits[len]);
+    table.values.clear();
+    for (int size = 1; size <= 256; size++) {
+	for (int i = 0; i < 256; i++) {
+	    if (code_size[i] == size) table.values.push_back(static_cast<unsigned char>(i));
+	}
+    }
+    codecHuffPrepare(table);
+}
+
+/*
+ * The typical Huffman tables of the JPEG standard (Annex K.3), for the luminance DC and AC coefficients: the number of codes
+ * of each length from 1 to 16, then the symbols by increasing code length.
+ */
+static const unsigned char codec_k3_dc_bits[CODEC_HUFF_MAX_BITS] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const unsigned char codec_k3_dc_values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char codec_k3_ac_bits[CODEC_HUFF_MAX_BITS] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125};
+static const unsigned char codec_k3_ac_values[] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32,
+    0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+    0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94,
+    0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+    0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+
+/**
+ * Builds a table close to one of Annex K.3 that also codes the symbols it lacks. The standard tables stop at category 11
+ * for the DCs and 10 for the ACs, while the levels here can take up to 15 bits, so the table is rebuilt by codecHuffBuild()
+ * from frequencies that give the standard symbols their code lengths back, plus the least frequency for the others.
+ * @param bits The number of codes of each length of the standard table.
+ * @param values The symbols of the standard table.
+ * @param symbols Whether each of the 256 symbols can be emitted by the encoder.
+ * @param table Filled with the table.
+ */
+static void codecTypicalTable(const unsigned char* bits, const unsigned char* values, const bool* symbols,
+			      CodecHuffTable& table) {
+    unsigned long freq[256] = {0};
+    for (int sym = 0; sym < 256; sym++) {
+	if (symbols[sym]) freq[sym] = 1;
+    }
+    for (int len = 1, k = 0; len <= CODEC_HUFF_MAX_BITS; len++) {
+	for (int i = 0; i < bits[len - 1]; i++) freq[values[k++]] = 1ul << (24 - len);
+    }
+    codecHuffBuild(freq, table);
+}
+
+/**
+ * The tables codecEncodeStreaming() codes an image with in a single pass, when there are no statistics to build them from.
+ */
+struct CodecTypicalTables {
+    CodecHuffTable tables[2];  // DC, AC
+
+    CodecTypicalTables() {
+	bool dc_symbols[256] = {false}, ac_symbols[256] = {false};
+	for (int category = 0; category <= 15; category++) dc_symbols[category] = true;
+	ac_symbols[0x00] = ac_symbols[0xF0] = true;  // EOB, ZRL
+	for (int run = 0; run < 16; run++) {
+	    for (int category = 1; category <= 15; category++) ac_symbols[run << 4 | category] = true;
+	}
+	codecTypicalTable(codec_k3_dc_bits, codec_k3_dc_values, dc_symbols, tables[0]);
+	codecTypicalTable(codec_k3_ac_bits, codec_k3_ac_values, ac_symbols, tables[1]);
+    }
+};
+
+static const CodecHuffTable* codecTypicalTables() {
+    static const CodecTypicalTables typical;  // Built once, by the first thread that needs them
+    return typical.tables;
+}
+
+/**
+ * Packs bits MSB first into a byte vector.
+ */
+struct CodecBitWriter {
+    std::vector<unsigned char>& out;
+    uint64_t acc;
+    int count;
+
+    explicit CodecBitWriter(std::vector<unsigned char>& out) : out(out), acc(0), count(0) {}
+    void put(unsigned bits, int n) {
+	acc = (acc << n) | (bits & ((1u << n) - 1));
+	count += n;
+	while (count >= 8) {
+	    count -= 8;
+	    out.push_back(static_cast<unsigned char>(acc >> count));
+	}
+    }
+    void flush() {
+	if (count > 0) put(0xFF, 8 - count);  // Pad with ones
+    }
+};
+
+/**
+ * Reads bits MSB first from a byte buffer. Reading past the end yields ones, and is reported by overrun().
+ */
+struct CodecBitReader {
+    const unsigned char* cur;
+    const unsigned char* end;
+    uint64_t acc;  // The next bits, aligned to the MSB
+    int count;
+    size_t padding;
+
+    CodecBitReader(const unsigned char* begin, const unsigned char* end)
+	: cur(begin), end(end), acc(0), count(0), padding(0) {}
+    void fill() {
+	while (count <= 56) {
+	    uint64_t byte = 0xFF;
+	    if (cur < end) {
+		byte = *cur++;
+	    } else {
+		padding++;
+	    }
+	    acc |= byte << (56 - count);
+	    count += 8;
+	}
+    }
+    unsigned peek(int n) {
+	if (count < n) fill();
+	return static_cast<unsigned>(acc >> (64 - n));
+    }
+    void skip(int n) {
+	acc <<= n;
+	count -= n;
+    }
+    unsigned get(int n) {
+	if (n == 0) return 0;
+	unsigned bits = peek(n);
+	skip(n);
+	return bits;
+    }
+    bool overrun() const { return padding * 8 > static_cast<size_t>(count); }
+};
+
+static inline int codecHuffDecode(CodecBitReader& reader, const CodecHuffTable& table) {
+    unsigned entry = table.lookup[reader.peek(CODEC_HUFF_LOOKUP_BITS)];
+    if (entry != 0) {
+	reader.skip(static_cast<int>(entry >> 8));
+	return static_cast<int>(entry & 0xFF);
+    }
+    unsigned bits = reader.peek(CODEC_HUFF_MAX_BITS);
+    for (int len = CODEC_HUFF_LOOKUP_BITS + 1; len <= CODEC_HUFF_MAX_BITS; len++) {
+	int code = static_cast<int>(bits >> (CODEC_HUFF_MAX_BITS - len));
+	if (code <= table.max_code[len]) {
+	    reader.skip(len);
+	    return table.values[table.first_value[len] + code - table.min_code[len]];
+	}
+    }
+    throw std::runtime_error("Corrupted stream: invalid Huffman code.");
+}
+
+/**
+ * @return The number of bits needed to represent the magnitude of a value (its JPEG category).
+ */
+static inline int codecCategory(int value) {
+    unsigned magnitude = static_cast<unsigned>(value < 0 ? -value : value);
+    int category = 0;
+    while (magnitude) {
+	category++;
+	magnitude >>= 1;
+    }
+    return category;
+}
+
+/**
+ * A symbol ready to be Huffman coded, followed by its extra bits (as many as the low nibble of the symbol says).
+ */
+struct CodecSymbol {
+    unsigned char table;  // 0 = DC, 1 = AC
+    unsigned char symbol;
+    unsigned short bits;
+};
+
+static inline void codecEmit(std::vector<CodecSymbol>& symbols, unsigned long* freq, int table, int symbol, int value,
+			     int category) {
+    CodecSymbol sym{};
+    sym.table = static_cast<unsigned char>(table);
+    sym.symbol = static_cast<unsigned char>(symbol);
+    sym.bits = static_cast<unsigned short>(value >= 0 ? value : value + (1 << category) - 1);
+    symbols.push_back(sym);
+    freq[table * 256 + symbol]++;
+}
+
+/**
+ * Transforms a chunk with samples of type T (see my_dct_typed.h). The level shift is applied to the pixels, so that the
+ * fixed-point samples only need room for [-128, 128).
+ * @param view The chunk.
+ * @param coeffs Filled with the coefficients, level shifted like the double precision ones once the DC is adjusted.
+ */
+template <typename T>
+static void codecForwardTyped(const ChunkView& view, double* coeffs) {
+    static thread_local MyTypedDCTWorkspace<T> ws;
+    static thread_local std::vector<T> tile;
+    int cw = view.width, area = cw * cw;
+    int frac_bits = MyTypedDCTFracBits<T>(128.0, cw, cw);
+    tile.resize(area);
+    for (int y = 0; y < cw; y++) {
+	const unsigned char* src = view.origin + y * view.stride;
+	for (int x = 0; x < cw; x++) tile[y * cw + x] = MyDCTSample<T>::fromInt(src[x] - 128, frac_bits);
+    }
+    MyTypedDDCT2(&tile.front(), cw, &tile.front(), cw, cw, cw, ws);
+    for (int i = 0; i < area; i++) coeffs[i] = MyDCTSample<T>::toDouble(tile[i], frac_bits);
+}
+
+/**
+ * Inverse of codecForwardTyped().
+ * @param coeffs The level shifted coefficients.
+ * @param origin Where the top-left pixel of the chunk goes.
+ * @param stride The distance between two consecutive rows of pixels.
+ * @param cw The width of the chunk.
+ */
+template <typename T>
+static void codecInverseTyped(const double* coeffs, unsigned char* origin, ptrdiff_t stride, int cw) {
+    static thread_local MyTypedDCTWorkspace<T> ws;
+    static thread_local std::vector<T> tile;
+    static thread_local std::vector<double> row;
+    int area = cw * cw;
+    int frac_bits = MyTypedDCTFracBits<T>(128.0, cw, cw);
+    tile.resize(area);
+    row.resize(cw);
+    for (int i = 0; i < area; i++) tile[i] = MyDCTSample<T>::fromDouble(coeffs[i], frac_bits);
+    MyTypedDIDCT2(&tile.front(), cw, &tile.front(), cw, cw, cw, ws);
+    for (int y = 0; y < cw; y++) {
+	for (int x = 0; x < cw; x++) row[x] = MyDCTSample<T>::toDouble(tile[y * cw + x], frac_bits) + 128.0;
+	storePixels(&row.front(), origin + y * stride, cw);
+    }
+}
+
+/**
+ * The part of the encoder that is shared by all the bands.
+ */
+struct CodecEncoder {
+    int chunk_width, diag_cut, precision;
+    std::shared_ptr<const DctPlan> plan;  // For the double precision path only
+    std::vector<double> quant;
+    const std::vector<unsigned>* zigzag;
+};
+
+/**
+ * Transforms, quantizes and scans a band of chunks, turning it into symbols.
+ * @param enc The encoder.
+ * @param rows The top-left pixel of the band, whose rows are stride bytes apart.
+ * @param stride The distance between two consecutive rows of pixels.
+ * @param chunks The number of chunks in the band.
+ * @param symbols Filled with the symbols of the band.
+ * @param freq The frequencies of the DC (first 256) and AC (last 256) symbols, to be updated.
+ * @param stats The stage times, to be updated.
+ */
+static void codecEncodeBand(const CodecEncoder& enc, const unsigned char* rows, ptrdiff_t stride, int chunks,
+			    std::vector<CodecSymbol>& symbols, unsigned long* freq, CodecStats& stats) {
+    static thread_local ChunkScratch scratch;
+    static thread_local std::vector<int> levels;
+    static thread_local std::vector<double> band_coeffs;
+    int cw = enc.chunk_width, area = cw * cw;
+    scratch.tile.resize(area);
+    scratch.coeffs.resize(area);
+    levels.resize(area);
+    const std::vector<unsigned>& zigzag = *enc.zigzag;
+    timespec_t ts;
+    int prev_dc = 0;
+    symbols.clear();
+    bool batched = enc.plan && enc.plan->getKernel() == DCT_PLAN_KERNEL_BATCH;
+    if (batched) {  // The whole band goes through a single call
+	nsec_t t0 = HTime_GetNsDelta(&ts);
+	band_coeffs.resize(static_cast<size_t>(chunks) * area);
+	for (int chunk = 0; chunk < chunks; chunk++) loadChunk({rows + chunk * cw, stride, cw}, &band_coeffs[chunk * area]);
+	enc.plan->forwardBlocks(&band_coeffs.front(), &band_coeffs.front(), chunks, &scratch.ws);
+	stats.transform_ns += HTime_GetNsDelta(&ts) - t0;
+    }
+    for (int chunk = 0; chunk < chunks; chunk++) {
+	nsec_t t0 = HTime_GetNsDelta(&ts);
+	ChunkView view{rows + chunk * cw, stride, cw};
+	double* coeffs = batched ? &band_coeffs[chunk * area] : &scratch.coeffs.front();
+	switch (batched ? -1 : enc.precision) {
+	    case -1:
+		coeffs[0] -= 128.0 * cw;
+		break;
+	    case MYDCT_PRECISION_FLOAT:
+		codecForwardTyped<float>(view, &scratch.coeffs.front());
+		break;
+	    case MYDCT_PRECISION_FIXED32:
+		codecForwardTyped<int32_t>(view, &scratch.coeffs.front());
+		break;
+	    case MYDCT_PRECISION_FIXED16:
+		codecForwardTyped<int16_t>(view, &scratch.coeffs.front());
+		break;
+	    default:
+		loadChunk(view, &scratch.tile.front());
+		enc.plan->forward(&scratch.tile.front(), cw, coeffs, cw, &scratch.ws);
+		coeffs[0] -= 128.0 * cw;  // Level shift, applied to the DC (which is cw times the average)
+	}
+	nsec_t t1 = HTime_GetNsDelta(&ts);
+	for (int k = 0; k < area; k++) {
+	    unsigned idx = zigzag[k];
+	    if (static_cast<int>(idx / cw + idx % cw) >= enc.diag_cut) {  // Cut the frequencies below the diagonal
+		levels[k] = 0;
+		continue;
+	    }
+	    long level = lround(coeffs[idx] / enc.quant[idx]);
+	    levels[k] = static_cast<int>(std::min(32767l, std::max(-32767l, level)));
+	}
+	nsec_t t2 = HTime_GetNsDelta(&ts);
+	int diff = levels[0] - prev_dc;
+	prev_dc = levels[0];
+	int category = codecCategory(diff);
+	codecEmit(symbols, freq, 0, category, diff, category);
+	int run = 0;
+	for (int k = 1; k < area; k++) {
+	    if (levels[k] == 0) {
+		run++;
+		continue;
+	    }
+	    for (; run > 15; run -= 16) codecEmit(symbols, freq, 1, 0xF0, 0, 0);  // ZRL
+	    category = codecCategory(levels[k]);
+	    codecEmit(symbols, freq, 1, run << 4 | category, levels[k], category);
+	    run = 0;
+	}
+	if (run > 0) codecEmit(symbols, freq, 1, 0x00, 0, 0);  // EOB
+	nsec_t t3 = HTime_GetNsDelta(&ts);
+	stats.transform_ns += t1 - t0;
+	stats.quantize_ns += t2 - t1;
+	stats.entropy_ns += t3 - t2;
+    }
+}
+
+static inline void codecPutU16(std::vector<unsigned char>& out, unsigned value) {
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static inline void codecPutU32(std::vector<unsigned char>& out, unsigned long value) {
+    codecPutU16(out, static_cast<unsigned>(value & 0xFFFF));
+    codecPutU16(out, static_cast<unsigned>(value >> 16 & 0xFFFF));
+}
+
+/**
+ * Checks the parameters of an encoder and prepares its tables.
+ * @throws std::invalid_argument If the chunk size is not supported.
+ */
+static void codecSetupEncoder(CodecEncoder& enc, int chunk_width, int& diag_cut, int& quality, int backend, int precision) {
+    if (chunk_width < 1 || chunk_width > CODEC_MAX_CHUNK_WIDTH) throw std::invalid_argument("Unsupported chunk size.");
+    if (precision < MYDCT_PRECISION_DOUBLE || precision > MYDCT_PRECISION_FIXED16)
+	throw std::invalid_argument("Unsupported precision.");
+    enc.precision = precision;
+    quality = std::min(100, std::max(1, quality));
+    diag_cut = std::min(0xFFFF, std::max(0, diag_cut));
+    enc.chunk_width = chunk_width;
+    enc.diag_cut = diag_cut;
+    if (precision == MYDCT_PRECISION_DOUBLE) enc.plan = codecPlan(backend, chunk_width);
+    codecQuantTable(chunk_width, quality, enc.quant);
+    enc.zigzag = &codecZigZag(chunk_width);
+}
+
+/**
+ * Builds the DC and AC tables from the frequencies gathered by codecEncodeBand(), one set of 512 per band.
+ */
+static void codecBuildTables(const std::vector<unsigned long>& band_freq, CodecHuffTable* tables) {
+    unsigned long freq[512] = {0};
+    for (size_t i = 0; i < band_freq.size(); i++) freq[i % 512] += band_freq[i];
+    codecHuffBuild(freq, tables[0]);
+    codecHuffBuild(freq + 256, tables[1]);
+}
+
+/**
+ * Huffman codes the symbols of a band, then frees them.
+ */
+static void codecPackBand(const CodecHuffTable* tables, std::vector<CodecSymbol>& symbols, std::vector<unsigned char>& bytes) {
+    bytes.clear();
+    CodecBitWriter writer(bytes);
+    for (const CodecSymbol& sym : symbols) {
+	const CodecHuffTable& table = tables[sym.table];
+	writer.put(table.code[sym.symbol], table.length[sym.symbol]);
+	writer.put(sym.bits, sym.symbol & 0x0F);
+    }
+    writer.flush();
+    std::vector<CodecSymbol>().swap(symbols);
+}
+
+/**
+ * Writes everything that precedes the band sizes.
+ */
+static void codecPutHeader(std::vector<unsigned char>& out, const CodecEncoder& enc, int quality, int width, int height,
+			   const CodecHuffTable* tables) {
+    out.insert(out.end(), CODEC_MAGIC, CODEC_MAGIC + 4);
+    out.push_back(CODEC_VERSION);
+    out.push_back(static_cast<unsigned char>(quality));
+    codecPutU16(out, static_cast<unsigned>(enc.chunk_width));
+    codecPutU16(out, static_cast<unsigned>(enc.diag_cut));
+    codecPutU32(out, static_cast<unsigned long>(width));
+    codecPutU32(out, static_cast<unsigned long>(height));
+    for (int i = 0; i < 2; i++) {
+	out.insert(out.end(), tables[i].bits + 1, tables[i].bits + CODEC_HUFF_MAX_BITS + 1);
+	out.insert(out.end(), tables[i].values.begin(), tables[i].values.end());
+    }
+}
+
+static void codecSumStats(const std::vector<CodecStats>& band_stats, CodecStats& stats) {
+    for (const CodecStats& band : band_stats) {
+	stats.transform_ns += band.transform_ns;
+	stats.quantize_ns += band.quantize_ns;
+	stats.entropy_ns += band.entropy_ns;
+    }
+}
+
+/**
+ * Encodes a grayscale image. Only the whole chunks are encoded: the pixels that exceed the last full chunk on the right and
+ * at the bottom are discarded, like the preview compressor always did.
+ * @param pixels The top-left pixel of the image.
+ * @param stride The distance between two consecutive rows of pixels.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param chunk_width The width of the chunks (1 to CODEC_MAX_CHUNK_WIDTH).
+ * @param diag_cut The coefficients whose row and column sum up to this or more are discarded.
+ * @param quality The quality, from 1 to 100 (see codecQuantTable()).
+ * @param backend The DCT implementation.
+ * @param precision The sample type of the transform (MYDCT_PRECISION_*): anything but double uses the typed transforms
+ * from my_dct_typed.h, whatever the backend.
+ * @param stats If not nullptr, filled with the stage times.
+ * @param progress If not nullptr, advanced by one step per band of chunks once it's been transformed; if it gets
+ * cancelled, the encoding stops with JobCancelled.
+ * @return The encoded image.
+ */
+std::vector<unsigned char> codecEncode(const unsigned char* pixels, ptrdiff_t stride, int width, int height, int chunk_width,
+				       int diag_cut, int quality, int backend, int precision, CodecStats* stats,
+				       JobProgress* progress) {
+    CodecEncoder enc;
+    codecSetupEncoder(enc, chunk_width, diag_cut, quality, backend, precision);
+    int bands = height / chunk_width, chunks = width / chunk_width;
+    std::vector<std::vector<CodecSymbol>> band_symbols(bands);
+    std::vector<std::vector<unsigned char>> band_bytes(bands);
+    std::vector<unsigned long> band_freq(static_cast<size_t>(bands) * 512, 0);
+    std::vector<CodecStats> band_stats(bands, CodecStats());
+    ThreadPool& pool = getSharedThreadPool();
+    pool.parallelFor(0, bands, [&](size_t first, size_t last) {
+	for (size_t band = first; band < last; band++) {
+	    if (progress != nullptr) progress->checkCancelled();
+	    codecEncodeBand(enc, pixels + static_cast<ptrdiff_t>(band) * chunk_width * stride, stride, chunks, band_symbols[band],
+			    &band_freq[band * 512], band_stats[band]);
+	    if (progress != nullptr) progress->step();
+	}
+    }, 1);
+    timespec_t ts;
+    nsec_t t0 = HTime_GetNsDelta(&ts);
+    CodecHuffTable tables[2];
+    codecBuildTables(band_freq, tables);
+    nsec_t t1 = HTime_GetNsDelta(&ts);
+    pool.parallelFor(0, bands, [&](size_t first, size_t last) {
+	timespec_t band_ts;
+	for (size_t band = first; band < last; band++) {
+	    nsec_t start = HTime_GetNsDelta(&band_ts);
+	    codecPackBand(tables, band_symbols[band], band_bytes[band]);
+	    band_stats[band].entropy_ns += HTime_GetNsDelta(&band_ts) - start;
+	}
+    }, 1);
+    std::vector<unsigned char> out;
+    codecPutHeader(out, enc, quality, chunks * chunk_width, bands * chunk_width, tables);
+    for (const auto& bytes : band_bytes) codecPutU32(out, bytes.size());
+    for (const auto& bytes : band_bytes) out.insert(out.end(), bytes.begin(), bytes.end());
+    if (stats != nullptr) {
+	*stats = CodecStats();
+	codecSumStats(band_stats, *stats);
+	stats->entropy_ns += t1 - t0;
+	stats->raw_bytes = static_cast<size_t>(chunks) * chunk_width * bands * chunk_width;
+	stats->encoded_bytes = out.size();
+    }
+    return out;
+}
+
+/**
+ * Encodes a grayscale image straight to a file, reading only a few bands of rows at a time, so that memory stays
+ * proportional to the width of the image (times the chunk size and the number of threads) whatever its height. Since the
+ * Huffman tables come before the bands, there are no statistics to build them from when the first band is written: the
+ * image is coded in a single pass with the typical tables of the JPEG standard (see codecTypicalTables()), which are
+ * recorded in the header like optimized ones would be, so the decoder doesn't tell the difference. With optimize_tables,
+ * the image is read twice instead, the first pass only gathering the statistics, and the result is the same codecEncode()
+ * would produce. Either way, the band sizes are written last, where room has been left for them.
+ * @param source Reads the given rows of the image (see CodecRowSource), in order, and each of them once (unless
+ * optimize_tables is set).
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @param chunk_width The width of the chunks (1 to CODEC_MAX_CHUNK_WIDTH).
+ * @param diag_cut The coefficients whose row and column sum up to this or more are discarded.
+ * @param quality The quality, from 1 to 100 (see codecQuantTable()).
+ * @param backend The DCT implementation.
+ * @param precision The sample type of the transform (see codecEncode()).
+ * @param path The file to write.
+ * @param stats If not nullptr, filled with the stage times (of both passes, if there are two).
+ * @param optimize_tables Whether to build the tables from the statistics of the image, at the cost of a second pass.
+ * @throws std::runtime_error If the file can't be written, or whatever source throws.
+ */
+void codecEncodeStreaming(const CodecRowSource& source, int width, int height, int chunk_width, int diag_cut, int quality,
+			  int backend, int precision, const std::string& path, CodecStats* stats, bool optimize_tables) {
+    CodecEncoder enc;
+    codecSetupEncoder(enc, chunk_width, diag_cut, quality, backend, precision);
+    int bands = height / chunk_width, chunks = width / chunk_width;
+    ThreadPool& pool = getSharedThreadPool();
+    int group = std::max(1, std::min(bands, static_cast<int>(pool.getThreadCount())));  // Bands in memory at once
+    size_t band_size = static_cast<size_t>(chunk_width) * width;
+    std::vector<unsigned char> rows(band_size * group);
+    std::vector<std::vector<CodecSymbol>> band_symbols(group);
+    std::vector<std::vector<unsigned char>> band_bytes(group);
+    std::vector<unsigned long> band_freq(static_cast<size_t>(group) * 512, 0);
+    std::vector<CodecStats> band_stats(group, CodecStats());
+    auto encodeGroup = [&](int first, int count, const CodecHuffTable* tables) {
+	source(first * chunk_width, count * chunk_width, &rows.front(), width);
+	pool.parallelFor(0, count, [&](size_t begin, size_t end) {
+	    timespec_t band_ts;
+	    for (size_t i = begin; i < end; i++) {
+		codecEncodeBand(enc, &rows[i * band_size], width, chunks, band_symbols[i], &band_freq[i * 512], band_stats[i]);
+		if (tables == nullptr) continue;
+		nsec_t start = HTime_GetNsDelta(&band_ts);
+		codecPackBand(tables, band_symbols[i], band_bytes[i]);
+		band_stats[i].entropy_ns += HTime_GetNsDelta(&band_ts) - start;
+	    }
+	}, 1);
+    };
+
+    const CodecHuffTable* tables = codecTypicalTables();
+    CodecHuffTable optimized[2];
+    if (optimize_tables) {
+	for (int first = 0; first < bands; first += group) encodeGroup(first, std::min(group, bands - first), nullptr);
+	codecBuildTables(band_freq, optimized);
+	tables = optimized;
+    }
+
+    std::ofstream file(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!file) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    std::vector<unsigned char> out;
+    codecPutHeader(out, enc, quality, chunks * chunk_width, bands * chunk_width, tables);
+    size_t sizes_at = out.size();
+    out.resize(sizes_at + static_cast<size_t>(bands) * 4, 0);  // Filled in at the end
+    file.write(reinterpret_cast<const char*>(&out.front()), static_cast<std::streamsize>(out.size()));
+    std::vector<unsigned char> sizes;
+    size_t total = out.size();
+    for (int first = 0; first < bands; first += group) {
+	int count = std::min(group, bands - first);
+	encodeGroup(first, count, tables);
+	for (int i = 0; i < count; i++) {
+	    codecPutU32(sizes, band_bytes[i].size());
+	    if (!band_bytes[i].empty())
+		file.write(reinterpret_cast<const char*>(&band_bytes[i].front()),
+			   static_cast<std::streamsize>(band_bytes[i].size()));
+	    total += band_bytes[i].size();
+	}
+    }
+    if (!sizes.empty()) {
+	file.seekp(static_cast<std::streamoff>(sizes_at));
+	file.write(reinterpret_cast<const char*>(&sizes.front()), static_cast<std::streamsize>(sizes.size()));
+    }
+    file.close();
+    if (!file) throw std::runtime_error("An I/O error occurred while writing the file.");
+    if (stats != nullptr) {
+	*stats = CodecStats();
+	codecSumStats(band_stats, *stats);
+	stats->raw_bytes = static_cast<size_t>(chunks) * chunk_width * bands * chunk_width;
+	stats->encoded_bytes = total;
+    }
+}
+
+/**
+ * Reads the fields of a stream in order, checking that it doesn't end prematurely.
+ */
+struct CodecParser {
+    const std::vector<unsigned char>& in;
+    size_t pos;
+
+    explicit CodecParser(const std::vector<unsigned char>& in) : in(in), pos(0) {}
+    const unsigned char* take(size_t n) {
+	if (in.size() - pos < n) throw std::runtime_error("Corrupted stream: unexpected end of data.");
+	pos += n;
+	return &in[pos - n];
+    }
+    size_t left() const { return in.size() - pos; }
+    unsigned u8() { return *take(1); }
+    unsigned u16() {
+	const unsigned char* p = take(2);
+	return p[0] | p[1] << 8;
+    }
+    unsigned long u32() {
+	unsigned long lo = u16();
+	return lo | static_cast<unsigned long>(u16()) << 16;
+    }
+};
+
+/**
+ * @return The least number of bytes that the band sizes and the payload of an image with the given header can take: 4
+ * bytes per band, plus a DC code and an EOB (at least one bit each) per chunk.
+ */
+static unsigned long long codecMinBodySize(const CodecHeader& header) {
+    unsigned long long bands = header.height / header.chunk_width, chunks = header.width / header.chunk_width;
+    unsigned long long bits_per_chunk = header.chunk_width > 1 ? 2 : 1;  // A single pixel has no AC coefficients
+    return 4 * bands + (bands * chunks * bits_per_chunk + 7) / 8;
+}
+
+static CodecHeader codecParseHeader(CodecParser& parser) {
+    if (std::memcmp(parser.take(4), CODEC_MAGIC, 4) != 0) throw std::runtime_error("Not an encoded image.");
+    if (parser.u8() != CODEC_VERSION) throw std::runtime_error("Unsupported version of the encoded image format.");
+    CodecHeader header{};
+    header.quality = static_cast<int>(parser.u8());
+    header.chunk_width = static_cast<int>(parser.u16());
+    header.diag_cut = static_cast<int>(parser.u16());
+    unsigned long width = parser.u32(), height = parser.u32();
+    if (header.chunk_width < 1 || header.chunk_width > CODEC_MAX_CHUNK_WIDTH || header.quality < 1 || header.quality > 100 ||
+	width % header.chunk_width != 0 || height % header.chunk_width != 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF)
+	throw std::runtime_error("Corrupted stream: invalid header.");
+    header.width = static_cast<int>(width);
+    header.height = static_cast<int>(height);
+    // Both Huffman tables hold at least their code length counts, so the size has to be checked before anything gets
+    // allocated for an image this big
+    if (parser.left() < 2 * CODEC_HUFF_MAX_BITS || parser.left() - 2 * CODEC_HUFF_MAX_BITS < codecMinBodySize(header))
+	throw std::runtime_error("Corrupted stream: too short for the size of the image.");
+    return header;
+}
+
+/**
+ * @param stream The encoded image.
+ * @return The parameters the image has been encoded with (e.g. to allocate the buffer to decode it into).
+ * @throws std::runtime_error If the stream is not an encoded image.
+ */
+CodecHeader codecReadHeader(const std::vector<unsigned char>& stream) {
+    CodecParser parser(stream);
+    return codecParseHeader(parser);
+}
+
+/**
+ * Decodes an image encoded by codecEncode().
+ * @param stream The encoded image.
+ * @param pixels The top-left pixel of the buffer that will hold the image (whose size is given by codecReadHeader()).
+ * @param stride The distance between two consecutive rows of pixels in the buffer.
+ * @param backend The DCT implementation.
+ * @param precision The sample type of the inverse transform (MYDCT_PRECISION_*), which does not need to match the one
+ * used by the encoder.
+ * @param stats If not nullptr, filled with the stage times.
+ * @param progress If not nullptr, advanced by one step per decoded band; if it gets cancelled, the decoding stops with
+ * JobCancelled, leaving the image partially decoded.
+ * @throws std::runtime_error If the stream is corrupted.
+ */
+void codecDecode(const std::vector<unsigned char>& stream, unsigned char* pixels, ptrdiff_t stride, int backend,
+		 int precision, CodecStats* stats, JobProgress* progress) {
+    CodecParser parser(stream);
+    CodecHeader header = codecParseHeader(parser);
+    int cw = header.chunk_width, area = cw * cw;
+    int bands = header.height / cw, chunks = header.width / cw;
+    std::shared_ptr<const DctPlan> plan;
+    if (precision == MYDCT_PRECISION_DOUBLE) plan = codecPlan(backend, cw);
+    CodecHuffTable tables[2];
+    for (CodecHuffTable& table : tables) {
+	table.bits[0] = 0;
+	size_t count = 0;
+	for (int len = 1; len <= CODEC_HUFF_MAX_BITS; len++) count += table.bits[len] = static_cast<unsigned char>(parser.u8());
+	const unsigned char* values = parser.take(count);
+	table.values.assign(values, values + count);
+	codecHuffPrepare(table);
+    }
+    if (parser.left() < codecMinBodySize(header))
+	throw std::runtime_error("Corrupted stream: too short for the size of the image.");
+    std::vector<size_t> band_offset(bands + 1);
+    band_offset[0] = 0;
+    for (int band = 0; band < bands; band++) band_offset[band + 1] = band_offset[band] + parser.u32();
+    const unsigned char* payload = parser.take(band_offset[bands]);
+    std::vector<double> quant;
+    codecQuantTable(cw, header.quality, quant);
+    const std::vector<unsigned>& zigzag = codecZigZag(cw);
+    std::vector<CodecStats> band_stats(bands, CodecStats());
+    getSharedThreadPool().parallelFor(0, bands, [&](size_t first, size_t last) {
+	static thread_local ChunkScratch scratch;
+	static thread_local std::vector<int> levels;
+	static thread_local std::vector<double> band_coeffs;
+	scratch.tile.resize(area);
+	scratch.coeffs.resize(area);
+	levels.resize(area);
+	bool batched = plan && plan->getKernel() == DCT_PLAN_KERNEL_BATCH;
+	if (batched) band_coeffs.resize(static_cast<size_t>(chunks) * area);
+	timespec_t ts;
+	for (size_t band = first; band < last; band++) {
+	    if (progress != nullptr) progress->checkCancelled();
+	    CodecBitReader reader(payload + band_offset[band], payload + band_offset[band + 1]);
+	    CodecStats& band_stat = band_stats[band];
+	    int prev_dc = 0;
+	    for (int chunk = 0; chunk < chunks; chunk++) {
+		nsec_t t0 = HTime_GetNsDelta(&ts);
+		std::fill(levels.begin(), levels.end(), 0);
+		int category = codecHuffDecode(reader, tables[0]);
+		if (category > 15) throw std::runtime_error("Corrupted stream: invalid DC category.");
+		int bits = static_cast<int>(reader.get(category));
+		if (category > 0 && bits < 1 << (category - 1)) bits -= (1 << category) - 1;
+		prev_dc = levels[0] = prev_dc + bits;
+		for (int k = 1; k < area;) {
+		    int symbol = codecHuffDecode(reader, tables[1]);
+		    int run = symbol >> 4;
+		    category = symbol & 0x0F;
+		    if (category == 0) {
+			if (run != 15) break;  // EOB
+			k += 16;               // ZRL
+			continue;
+		    }
+		    k += run;
+		    if (k >= area) throw std::runtime_error("Corrupted stream: too many coefficients in a chunk.");
+		    bits = static_cast<int>(reader.get(category));
+		    if (bits < 1 << (category - 1)) bits -= (1 << category) - 1;
+		    levels[k++] = bits;
+		}
+		if (reader.overrun()) throw std::runtime_error("Corrupted stream: truncated band.");
+		nsec_t t1 = HTime_GetNsDelta(&ts);
+		double* coeffs = batched ? &band_coeffs[chunk * area] : &scratch.coeffs.front();
+		for (int k = 0; k < area; k++) coeffs[zigzag[k]] = levels[k] * quant[zigzag[k]];
+		nsec_t t2 = HTime_GetNsDelta(&ts);
+		unsigned char* origin = pixels + static_cast<ptrdiff_t>(band) * cw * stride + chunk * cw;
+		switch (batched ? -1 : precision) {
+		    case -1:  // Transformed along with the rest of the band, below
+			coeffs[0] += 128.0 * cw;
+			break;
+		    case MYDCT_PRECISION_FLOAT:
+			codecInverseTyped<float>(coeffs, origin, stride, cw);
+			break;
+		    case MYDCT_PRECISION_FIXED32:
+			codecInverseTyped<int32_t>(coeffs, origin, stride, cw);
+			break;
+		    case MYDCT_PRECISION_FIXED16:
+			codecInverseTyped<int16_t>(coeffs, origin, stride, cw);
+			break;
+		    default:
+			coeffs[0] += 128.0 * cw;
+			plan->inverse(coeffs, cw, &scratch.tile.front(), cw, &scratch.ws);
+			for (int row = 0; row < cw; row++) storePixels(&scratch.tile[row * cw], origin + row * stride, cw);
+		}
+		nsec_t t3 = HTime_GetNsDelta(&ts);
+		band_stat.entropy_ns += t1 - t0;
+		band_stat.quantize_ns += t2 - t1;
+		band_stat.transform_ns += t3 - t2;
+	    }
+	    if (batched) {
+		nsec_t t0 = HTime_GetNsDelta(&ts);
+		plan->inverseBlocks(&band_coeffs.front(), &band_coeffs.front(), chunks, &scratch.ws);
+		unsigned char* origin = pixels + static_cast<ptrdiff_t>(band) * cw * stride;
+		for (int chunk = 0; chunk < chunks; chunk++) {
+		    for (int row = 0; row < cw; row++) storePixels(&band_coeffs[chunk * area + row * cw], origin + row * stride + chunk * cw, cw);
+		}
+		band_stat.transform_ns += HTime_GetNsDelta(&ts) - t0;
+	    }
+	    if (progress != nullptr) progress->step();
+	}
+    }, 1);
+    if (stats != nullptr) {
+	*stats = CodecStats();
+	for (const CodecStats& band : band_stats) {
+	    stats->transform_ns += band.transform_ns;
+	    stats->quantize_ns += band.quantize_ns;
+	    stats->entropy_ns += band.entropy_ns;
+	}
+	stats->raw_bytes = static_cast<size_t>(header.width) * header.height;
+	stats->encoded_bytes = stream.size();
+    }
+}
+
+void codecSaveFile(const std::string& path, const std::vector<unsigned char>& stream) {
+    std::ofstream file(path, std::ofstream::out | std::ofstream::binary);
+    if (!file) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    file.write(reinterpret_cast<const char*>(stream.data()), static_cast<std::streamsize>(stream.size()));
+    if (!file) throw std::runtime_error("An I/O error occurred while writing the file.");
+}
+
+std::vector<unsigned char> codecLoadFile(const std::string& path) {
+    std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+    if (!file) throw std::runtime_error("An I/O error occurred while trying to open the file for reading.");
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @return The peak signal-to-noise ratio between two 8-bit images, in dB (infinity if they are identical).
+ */
+double codecPsnr(const unsigned char* a, ptrdiff_t a_stride, const unsigned char* b, ptrdiff_t b_stride, int width,
+		 int height) {
+    double sse = 0;
+    for (int y = 0; y < height; y++) {
+	const unsigned char* a_row = a + static_cast<ptrdiff_t>(y) * a_stride;
+	const unsigned char* b_row = b + static_cast<ptrdiff_t>(y) * b_stride;
+	for (int x = 0; x < width; x++) {
+	    double diff = static_cast<double>(a_row[x]) - b_row[x];
+	    sse += diff * diff;
+	}
+    }
+    if (sse == 0 || width <= 0 || height <= 0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 * width * height / sse);
+}
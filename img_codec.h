@@ -0,0 +1,123 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_IMG_CODEC_H
+#define PROJ2_IMG_CODEC_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "background_job.h"
+#include "dct_plan.h"
+#include "h_time.h"
+#include "my_dct.h"
+#include "my_dct_typed.h"
+
+#define COMPRESSOR_BACKEND_CV 0
+#define COMPRESSOR_BACKEND_MY 1
+#define COMPRESSOR_BACKEND_MY_FAST 2
+#define COMPRESSOR_BACKEND_MY_FIXED 3
+#define COMPRESSOR_BACKEND_AUTO 4
+#define COMPRESSOR_BACKEND_MY_BATCH 5
+
+#define CODEC_MAGIC "DCTC"
+#define CODEC_VERSION 1
+#define CODEC_DEFAULT_QUALITY 75
+#define CODEC_MAX_CHUNK_WIDTH 255
+#define CODEC_HUFF_MAX_BITS 16  // Longest Huffman code
+#define CODEC_HUFF_LOOKUP_BITS 9  // Codes up to this long are decoded with a single table lookup
+
+/**
+ * A chunk of an image, seen in place: its rows are stride bytes apart in the image data.
+ */
+struct ChunkView {
+    const unsigned char* origin;  // The top-left pixel
+    ptrdiff_t stride;
+    int width;
+};
+
+/**
+ * The buffers a thread needs to compress chunks, reused across bands (and across compressions, as long as the chunk size
+ * doesn't change).
+ */
+struct ChunkScratch {
+    std::vector<double> tile, coeffs;
+    MyDCTWorkspace ws;
+};
+
+/**
+ * The parameters of an encoded image, as stored in its header.
+ */
+struct CodecHeader {
+    int width, height;  // Multiples of chunk_width
+    int chunk_width;
+    int diag_cut;
+    int quality;
+};
+
+/**
+ * Where the time went while encoding or decoding an image. The stage times are summed across the threads that took part.
+ */
+struct CodecStats {
+    size_t raw_bytes;       // Pixels encoded or decoded
+    size_t encoded_bytes;   // Size of the stream
+    nsec_t transform_ns;    // Conversion and (inverse) DCT
+    nsec_t quantize_ns;     // Cut, (de)quantization and zig-zag scan
+    nsec_t entropy_ns;      // Run-length and Huffman (de)coding
+};
+
+/**
+ * Reads count rows of an image, starting from row first, into dst (whose rows are stride bytes apart). Used by
+ * codecEncodeStreaming() to get the image a few bands at a time.
+ */
+typedef std::function<void(int first, int count, unsigned char* dst, ptrdiff_t stride)> CodecRowSource;
+
+std::shared_ptr<const DctPlan> codecPlan(int, int);
+void loadChunk(const ChunkView&, double*);
+void storePixels(const double*, unsigned char*, int);
+void codecQuantTable(int, int, std::vector<double>&);
+const std::vector<unsigned>& codecZigZag(int);
+std::vector<unsigned char> codecEncode(const unsigned char*, ptrdiff_t, int, int, int, int, int = CODEC_DEFAULT_QUALITY,
+				       int = COMPRESSOR_BACKEND_AUTO, int = MYDCT_PRECISION_DOUBLE, CodecStats* = nullptr,
+				       JobProgress* = nullptr);
+void codecEncodeStreaming(const CodecRowSource&, int, int, int, int, int, int, int, const std::string&,
+			  CodecStats* = nullptr, bool = false);
+CodecHeader codecReadHeader(const std::vector<unsigned char>&);
+void codecDecode(const std::vector<unsigned char>&, unsigned char*, ptrdiff_t, int = COMPRESSOR_BACKEND_AUTO,
+		 int = MYDCT_PRECISION_DOUBLE, CodecStats* = nullptr, JobProgress* = nullptr);
+void codecSaveFile(const std::string&, const std::vector<unsigned char>&);
+std::vector<unsigned char> codecLoadFile(const std::string&);
+double codecPsnr(const unsigned char*, ptrdiff_t, const unsigned char*, ptrdiff_t, int, int);
+
+/**
+ * @return The throughput of a stage, in MB/s.
+ */
+inline double codecStageMBs(const CodecStats& stats, nsec_t stage_ns) {
+    if (stage_ns <= 0) return .0f;
+    return static_cast<double>(stats.raw_bytes) / (static_cast<double>(stage_ns) / NSEC_PER_SEC) / 1e6;
+}
+
+#endif  // PROJ2_IMG_CODEC_H
@@ -25,45 +25,65 @@
 
 #include <GL/gl.h>
 
+#include <strings.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <string>
 
+#include "background_job.h"
+#include "bmp_reader.h"
 #include "h_time.h"
 #include "opencv2/opencv.hpp"
+#include "perf_counters.h"
 #include "stb_image.h"
+#include "thread_pool.h"
 
-struct ChunkCoord {
-    int vertical_chunks, vertical_idx, col, horizontal_chunks, horizontal_idx, row;
-};
-
-inline ChunkCoord toChunkCoord(int img_col, int img_row, int img_width, int img_height, int chunk_width) {
-    ChunkCoord ret{};
-    ret.vertical_chunks = static_cast<int>(floor(img_height / (double)chunk_width));
-    ret.horizontal_chunks = static_cast<int>(floor(img_width / (double)chunk_width));
-    ret.vertical_idx = img_row / chunk_width;
-    ret.horizontal_idx = img_col / chunk_width;
-    ret.row = img_row % chunk_width;
-    ret.col = img_col % chunk_width;
-    return ret;
+static bool imgHasExtension(const std::string& path, const char* ext) {
+    size_t len = strlen(ext);
+    return path.size() > len && strcasecmp(path.c_str() + path.size() - len, ext) == 0;
 }
 
 class Image {
    private:
-    cv::Mat data;
+    cv::Mat data;                         // The pixels, when they've been decoded into a buffer of our own
+    std::shared_ptr<const void> storage;  // Whatever else holds the pixels (a mapped file, an stb_image buffer)
+    const unsigned char* origin;          // The top-left pixel, wherever it is
+    ptrdiff_t stride;                     // The distance between two consecutive rows (negative for bottom-up files)
+    int width, height;
+    const char* source;  // How the pixels have been obtained
     std::string path;
     GLuint texture{};
+    std::vector<unsigned char> encoded;  // The stream this image has been decoded from, if it has been compressed
+
+    void setView(const unsigned char* m_origin, ptrdiff_t m_stride, int m_width, int m_height, const char* m_source) {
+	origin = m_origin;
+	stride = m_stride;
+	width = m_width;
+	height = m_height;
+	source = m_source;
+    }
+    void viewData(const char* m_source) {
+	storage.reset();
+	setView(data.ptr<unsigned char>(), static_cast<ptrdiff_t>(data.step), data.cols, data.rows, m_source);
+    }
 
    public:
     Image() {
 	data = cv::Mat(0, 0, CV_8U);
+	viewData("");
 	path = "";
 	texture = 0;
     };
     virtual ~Image() = default;
 
-    int getHeight() const { return data.rows; }
-    int getWidth() const { return data.cols; }
+    int getHeight() const { return height; }
+    int getWidth() const { return width; }
     const std::string& getPath() const { return path; }
+    const char* getSource() const { return source; }
     GLuint getTexture() {
 	if (texture == 0) {
 	    glGenTextures(1, &texture);
@@ -80,23 +100,51 @@ class Image {
 	    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
 #endif
-	    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, data.cols, data.rows, 0, GL_RED, GL_UNSIGNED_BYTE, data.data);
+	    if (stride == width) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, origin);
+	    } else {  // Padded or bottom-up rows (e.g. straight from a BMP file) are uploaded one at a time
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+		for (int y = 0; y < height; y++)
+		    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, GL_RED, GL_UNSIGNED_BYTE, origin + y * stride);
+	    }
 	    if (texture == 0) throw std::runtime_error("Unable to create an OpenGL Texture");
 	}
 	return texture;
     }
-    ImVec2 getSize() const { return {static_cast<float>(data.cols), static_cast<float>(data.rows)}; }
-    unsigned char* getRawData() const { return data.data; }
+    ImVec2 getSize() const { return {static_cast<float>(width), static_cast<float>(height)}; }
+    const unsigned char* getRawData() const { return origin; }
+    ptrdiff_t getStride() const { return stride; }
 
+    /**
+     * Loads an image. Uncompressed BMP files are memory mapped and, if they hold 8-bit grayscale pixels, used in place
+     * (see BmpMapping); anything else goes through stb_image, which decodes the file into a buffer that is then used as is.
+     * @throws std::runtime_error If the file can't be loaded.
+     */
     void load(const std::string& m_path) {
-	int ok, rows, cols, comp;
-	ok = stbi_info(m_path.c_str(), &rows, &cols, &comp);
-	if (!ok) throw std::runtime_error("Unable to locate or decode the specified image file.");
-	auto buf = stbi_load(m_path.c_str(), &cols, &rows, nullptr, 1);
-	if (buf == nullptr) throw std::runtime_error("An error occured while loading the specified image file.");
-	data = cv::Mat(rows, cols, CV_8U);
-	std::memcpy(data.data, buf, data.rows * data.cols);
-	stbi_image_free(buf);
+	if (imgHasExtension(m_path, ".dctc")) {  // An encoded image
+	    encoded = codecLoadFile(m_path);
+	    decode(encoded);
+	    this->path = m_path;
+	    return;
+	}
+	encoded.clear();
+	if (imgHasExtension(m_path, ".bmp")) {
+	    try {
+		std::shared_ptr<BmpMapping> mapping = std::make_shared<BmpMapping>(m_path);
+		setView(mapping->getOrigin(), mapping->getStride(), mapping->getWidth(), mapping->getHeight(),
+			mapping->isDirect() ? "mapped in place" : "decoded once from the mapped file");
+		storage = mapping;
+		this->path = m_path;
+		return;
+	    } catch (std::runtime_error&) {
+		// stb_image might still be able to read it
+	    }
+	}
+	int rows, cols;
+	unsigned char* buf = stbi_load(m_path.c_str(), &cols, &rows, nullptr, 1);
+	if (buf == nullptr) throw std::runtime_error("Unable to locate or decode the specified image file.");
+	storage = std::shared_ptr<const void>(buf, stbi_image_free);
+	setView(buf, cols, cols, rows, "decoded by stb_image");
 	this->path = m_path;
     }
 
@@ -104,103 +152,182 @@ class Image {
 	path = "";
 	glDeleteTextures(1, &texture);
 	texture = 0;
+	viewData("");  // Releases the mapping, if any
     }
 
-    std::vector<double> extractChunk(int chunk_width, int chunk_id_y, int chunk_id_x) const {
-	std::vector<double> ret;
-	int x, y;
-	for (int row = 0; row < chunk_width; row++) {
-	    y = row + (chunk_width * chunk_id_y);
-	    for (int col = 0; col < chunk_width; col++) {
-		x = col + (chunk_width * chunk_id_x);
-		// MAYBE try/catch?
-		ret.push_back(static_cast<double>(data.at<unsigned char>(y, x)));
-	    }
+    const std::vector<unsigned char>& getEncoded() const { return encoded; }
+
+    /**
+     * Replaces the image with the one held by an encoded stream.
+     * @throws std::runtime_error If the stream is corrupted.
+     */
+    void decode(const std::vector<unsigned char>& stream, int backend = COMPRESSOR_BACKEND_AUTO,
+		int precision = MYDCT_PRECISION_DOUBLE, CodecStats* stats = nullptr, JobProgress* progress = nullptr) {
+	CodecHeader header = codecReadHeader(stream);
+	try {
+	    data.create(header.height, header.width, CV_8U);  // Reuses the buffer if it fits
+	} catch (cv::Exception&) {
+	    throw std::runtime_error("Not enough memory to decode the image.");
+	} catch (std::bad_alloc&) {
+	    throw std::runtime_error("Not enough memory to decode the image.");
 	}
-	return ret;
+	codecDecode(stream, data.ptr<unsigned char>(), static_cast<ptrdiff_t>(data.step), backend, precision, stats,
+		    progress);
+	viewData("decoded from the stream");
     }
 
-    void makeCompressedOf(const Image& from_img, int chunk_width, int diag_cut) {
-	// Subdivide image in chunks
-	std::vector<std::vector<double>> chunks_in;
-	auto vertical_chunks = static_cast<int>(floor(from_img.getHeight() / (double)chunk_width));
-	auto horizontal_chunks = static_cast<int>(floor(from_img.getWidth() / (double)chunk_width));
-	for (int row = 0; row < vertical_chunks; row++) {
-	    for (int col = 0; col < horizontal_chunks; col++) {
-		chunks_in.push_back(from_img.extractChunk(chunk_width, row, col));
-	    }
-	}
-	int cur = 0;
-	// For each chunk
-	for (auto chunk : chunks_in) {
-	    // Allocate two buffers for the chunk's data
-	    cv::Mat mat1 = cv::Mat(chunk_width, chunk_width, CV_64F, &chunk.front());
-	    cv::Mat mat2 = cv::Mat(chunk_width, chunk_width, CV_64F);
-	    // Perform the DCT
-	    cv::dct(mat1, mat2);
-	    // Cut the frequencies below the diagonal
-	    for (int row = 0; row < chunk_width; row++) {
-		for (int col = 0; col < chunk_width; col++) {
-		    if ((col + row) >= diag_cut) mat2.at<double>(row, col) = .0f;
-		}
-	    }
-	    cv::idct(mat2, mat1);
-	    chunks_in.at(cur).assign(mat1.begin<double>(), mat1.end<double>());
-	    cur++;
-	    ~mat1;
-	    ~mat2;
+    /**
+     * Compresses an image for real: encodes it (see img_codec.cpp), keeping the stream around so that it can be saved, then
+     * decodes the stream into this image, so that what's shown is exactly what the stream holds. Doesn't touch OpenGL, so it
+     * can run on a background job (see adopt()). If enc_perf and dec_perf are given, the hardware counters of every thread of
+     * the process (the thread pool's workers included) are read during each of the two stages.
+     */
+    void makeCompressedOf(const Image& from_img, int chunk_width, int diag_cut, int quality = CODEC_DEFAULT_QUALITY,
+			  int backend = COMPRESSOR_BACKEND_AUTO, int precision = MYDCT_PRECISION_DOUBLE,
+			  CodecStats* enc_stats = nullptr, CodecStats* dec_stats = nullptr, JobProgress* progress = nullptr,
+			  PerfCounts* enc_perf = nullptr, PerfCounts* dec_perf = nullptr) {
+	std::unique_ptr<PerfCounters> counters;
+	if (enc_perf != nullptr && dec_perf != nullptr) counters.reset(new PerfCounters(PERF_SCOPE_PROCESS));
+	if (counters) counters->start();
+	encoded = codecEncode(from_img.origin, from_img.stride, from_img.width, from_img.height, chunk_width, diag_cut, quality,
+			      backend, precision, enc_stats, progress);
+	if (counters) {
+	    *enc_perf = counters->stop();
+	    counters->start();
 	}
-	// Repack the chunks
-	data = cv::Mat(vertical_chunks * chunk_width, horizontal_chunks * chunk_width, CV_8U);
-	auto buf = static_cast<unsigned char*>(std::malloc(data.cols * data.rows));
-	if (buf == nullptr) throw std::runtime_error("Cannot allocate the required memory for the data buffer.");
-	ChunkCoord cur_chunk{};
-	for (int row = 0; row < data.rows; row++) {
-	    for (int col = 0; col < data.cols; col++) {
-		cur_chunk = toChunkCoord(col, row, data.cols, data.rows, chunk_width);
-		double tmp = round(chunks_in.at((cur_chunk.horizontal_idx + cur_chunk.horizontal_chunks * cur_chunk.vertical_idx))
-				       .at(cur_chunk.col + chunk_width * cur_chunk.row));
-		if (tmp < .0f) {
-		    tmp = .0f;
-		} else if (tmp > 255.0f) {
-		    tmp = 255.0f;
-		}
-		buf[col + data.cols * row] = static_cast<unsigned char>(tmp);
-	    }
-	}
-	std::memcpy(data.data, buf, data.cols * data.rows);
-	std::free(buf);
+	decode(encoded, backend, precision, dec_stats, progress);
+	if (counters) *dec_perf = counters->stop();
+    }
+
+    /**
+     * Takes over the pixels and the stream of another image, which is left empty.
+     */
+    void adopt(Image& other) {
+	reset();
+	data = other.data;
+	storage = other.storage;
+	encoded.swap(other.encoded);
+	setView(other.origin, other.stride, other.width, other.height, other.source);
+	path = other.path;
+	other.encoded.clear();
+	other.data = cv::Mat(0, 0, CV_8U);
+	other.viewData("");
     }
+
+    /**
+     * Runs the same compression as makeCompressedOf() with the double precision transforms, without touching this image.
+     * @return The PSNR of this image against the result.
+     */
+    double psnrAgainstDoubleOf(const Image& from_img, int chunk_width, int diag_cut, int quality, int backend,
+			       JobProgress* progress = nullptr) const {
+	std::vector<unsigned char> stream =
+	    codecEncode(from_img.origin, from_img.stride, from_img.width, from_img.height, chunk_width, diag_cut, quality,
+			backend, MYDCT_PRECISION_DOUBLE, nullptr, progress);
+	CodecHeader header = codecReadHeader(stream);
+	std::vector<unsigned char> reference(static_cast<size_t>(header.width) * header.height);
+	codecDecode(stream, reference.data(), header.width, backend, MYDCT_PRECISION_DOUBLE, nullptr, progress);
+	return codecPsnr(origin, stride, reference.data(), header.width, std::min(width, header.width),
+			 std::min(height, header.height));
+    }
+
+    /**
+     * @return The PSNR of this image against another one, over the area they have in common.
+     */
+    double psnrAgainst(const Image& other) const {
+	return codecPsnr(origin, stride, other.origin, other.stride, std::min(width, other.width),
+			 std::min(height, other.height));
+    }
+};
+
+/**
+ * The outcome of a compression, filled by the background job.
+ */
+struct ImgCompressionRun {
+    int chunk_size, backend, precision, threads;
+    int kernel;  // The one the plan of the double precision path picked (DCT_PLAN_KERNEL_*)
+    CodecStats enc_stats, dec_stats;
+    bool counters;  // Whether enc_perf and dec_perf have been read
+    PerfCounts enc_perf, dec_perf;
+    double psnr, psnr_double;
+    long double elapsed_ns, double_ns;  // The latter for the double precision path, if it's been run
 };
 
 void imgCompressorWindow(bool* visible) {
     static Image from;
     static Image to;
+    static Image pending;  // Compressed by the job, then handed over to "to"
+    static BackgroundJob job;
     static bool from_loaded = false;
     static char from_path[128] = "../docs/Immagini/amogus_512.bmp";  // "./prova.bmp";
     static bool to_ready;
     static char io_status_msg[512] = "Ready.";
     static int chunk_size = 8;
     static int cutoff = 0;
+    static int quality = CODEC_DEFAULT_QUALITY;
+    static char to_path[128] = "./compressed.dctc";
+    static ImgCompressionRun run{}, shown{};  // The one being computed, the one that made the compressed image
+    static int backend = COMPRESSOR_BACKEND_AUTO;
+    static int precision = MYDCT_PRECISION_DOUBLE;
+    static int threads = static_cast<int>(ThreadPool::getDefaultThreadCount());
+    static bool counters = false;
+    static const std::string counters_error = PerfCounters().getError();  // Empty if they can be read
+    static const char* backend_names[] = {"cv::dct()", "MyDDCT2()", "MyFastDDCT2()", "MyFixedDDCT2()", "Auto", "MyBatchDDCT2()"};
+    if (job.poll()) {
+	if (job.wasCancelled()) {
+	    snprintf((char*)&io_status_msg, 512, "Compression cancelled after %Lf milliseconds, the previous result has been kept.",
+		     job.getElapsedNs() / NSEC_PER_MSEC);
+	} else if (!job.getError().empty()) {
+	    snprintf((char*)&io_status_msg, 512, "Unable to compress the image. Reason: %s", job.getError().c_str());
+	} else {
+	    to.adopt(pending);
+	    to_ready = true;
+	    shown = run;
+	    char backend_name[64];
+	    snprintf(backend_name, sizeof(backend_name), shown.backend == COMPRESSOR_BACKEND_AUTO ? "%s, planned" : "%s",
+		     dctPlanKernelName(shown.kernel));
+	    if (shown.precision != MYDCT_PRECISION_DOUBLE) {
+		snprintf((char*)&io_status_msg, 512,
+			 "Last compression (%s, %s, %d threads) took %Lf milliseconds, encoding and decoding "
+			 "(the double precision one took %.3Lf milliseconds, decoding included).",
+			 backend_name, MyDCTPrecisionName(shown.precision), shown.threads, shown.elapsed_ns / NSEC_PER_MSEC,
+			 shown.double_ns / NSEC_PER_MSEC);
+	    } else {
+		snprintf((char*)&io_status_msg, 512,
+			 "Last compression (%s, %d threads) took %Lf seconds (%Lf milliseconds), encoding and decoding.",
+			 backend_name, shown.threads, shown.elapsed_ns / NSEC_PER_SEC, shown.elapsed_ns / NSEC_PER_MSEC);
+	    }
+	}
+	pending.reset();
+    }
     ImGui::Begin(IMG_COMPRESSOR_WINDOW_TITLE, visible, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_AlwaysAutoResize);
     ImGui::InputText("##fromPathTextBox", from_path, IM_ARRAYSIZE(from_path));
     ImGui::SameLine();
     if (ImGui::Button("Load Image")) {
+	job.cancel();  // It reads the current image
+	job.wait();
+	pending.reset();
 	from_loaded = false;
 	try {
 	    from.reset();
 	    from_loaded = false;
 	    to.reset();
 	    to_ready = false;
+	    timespec_t ts;
+	    nsec_t ts_start = HTime_GetNsDelta(&ts);
 	    from.load(from_path);
+	    nsec_t ts_end = HTime_GetNsDelta(&ts);
 	    from_loaded = true;
-	    snprintf((char*)&io_status_msg, 512, "Image loaded.");
+	    snprintf((char*)&io_status_msg, 512, "Image loaded in %.3f milliseconds (%s).",
+		     static_cast<double>(ts_end - ts_start) / NSEC_PER_MSEC, from.getSource());
 	} catch (std::runtime_error& e) {
 	    snprintf((char*)&io_status_msg, 512, "Unable to load image \"%s\". Reason: %s", from_path, e.what());
 	}
     }
     ImGui::SameLine();
     if (ImGui::Button("Reset")) {
+	job.cancel();
+	job.wait();
+	pending.reset();
 	from.reset();
 	from_loaded = false;
 	to.reset();
@@ -210,23 +337,112 @@ void imgCompressorWindow(bool* visible) {
     if (from_loaded) {
 	ImGui::Separator();
 	ImGui::Text("Compression Parameters:");
+	ImGui::RadioButton(backend_names[COMPRESSOR_BACKEND_AUTO], &backend, COMPRESSOR_BACKEND_AUTO);
+	ImGui::SameLine();
+	ImGui::RadioButton(backend_names[COMPRESSOR_BACKEND_CV], &backend, COMPRESSOR_BACKEND_CV);
+	ImGui::SameLine();
+	ImGui::RadioButton(backend_names[COMPRESSOR_BACKEND_MY], &backend, COMPRESSOR_BACKEND_MY);
+	ImGui::SameLine();
+	ImGui::RadioButton(backend_names[COMPRESSOR_BACKEND_MY_FAST], &backend, COMPRESSOR_BACKEND_MY_FAST);
+	ImGui::SameLine();
+	ImGui::RadioButton(backend_names[COMPRESSOR_BACKEND_MY_BATCH], &backend, COMPRESSOR_BACKEND_MY_BATCH);
+	for (int p = MYDCT_PRECISION_DOUBLE; p <= MYDCT_PRECISION_FIXED16; p++) {
+	    if (p != MYDCT_PRECISION_DOUBLE) ImGui::SameLine();
+	    ImGui::RadioButton(MyDCTPrecisionName(p), &precision, p);
+	}
 	ImGui::SliderInt("Chunk Size", &chunk_size, 2, 100);
-	if (chunk_size % 2 != 0) {
-	    ImGui::Text("Please select an even chunk size!");
+	ImGui::SliderInt("Threads", &threads, 1, 64);
+	ImGui::Checkbox("Hardware Counters", &counters);
+	if (counters && !counters_error.empty()) {
+	    ImGui::SameLine();
+	    ImGui::TextWrapped("Unavailable. %s", counters_error.c_str());
+	}
+	if (chunk_size % 2 != 0 && backend == COMPRESSOR_BACKEND_CV) {
+	    ImGui::Text("Please select an even chunk size, or use one of the homegrown backends!");
 	} else {
 	    ImGui::SliderInt("Frequency Cutoff", &cutoff, 0, 2 * chunk_size - 2);
-	    if (ImGui::Button("Go!")) {
-		to_ready = false;
-		to.reset();
-		static timespec_t ts;
-		static nsec_t ts_start = 0, ts_end = -1;
-		static long double elapsed;
-		ts_start = HTime_GetNsDelta(&ts);  // Begin timing
-		to.makeCompressedOf(from, chunk_size, cutoff);
-		ts_end = HTime_GetNsDelta(&ts);  // End timing
-		to_ready = true;
-		elapsed = static_cast<long double>(ts_end - ts_start);
-		snprintf((char*)&io_status_msg, 512, "Last compression took %Lf seconds (%Lf milliseconds).", elapsed / NSEC_PER_SEC, elapsed / NSEC_PER_MSEC);
+	    ImGui::SliderInt("Quality", &quality, 1, 100);
+	    if (job.isBusy()) {
+		const JobProgress& progress = job.getProgress();
+		ImGui::ProgressBar(progress.getFraction(), ImVec2(240, 0));
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel")) job.cancel();
+		ImGui::SameLine();
+		ImGui::Text("%zu of %zu bands", static_cast<size_t>(progress.steps_done),
+			    static_cast<size_t>(progress.steps_total));
+	    } else if (BackgroundJob::getActiveCount() > 0) {  // The thread pool can't be resized under its feet
+		ImGui::Text("Waiting for the other background jobs to end...");
+	    } else if (ImGui::Button("Go!")) {
+		setSharedThreadCount(threads);
+		run.chunk_size = chunk_size;
+		run.backend = backend;
+		run.precision = precision;
+		run.threads = threads;
+		run.counters = counters && counters_error.empty();
+		int m_cutoff = cutoff, m_quality = quality;
+		size_t bands = static_cast<size_t>(from.getHeight() / chunk_size);
+		job.start(bands * (precision == MYDCT_PRECISION_DOUBLE ? 2 : 4), [=](JobProgress& progress) {
+		    timespec_t ts;
+		    nsec_t ts_start = HTime_GetNsDelta(&ts);  // Begin timing
+		    pending.makeCompressedOf(from, run.chunk_size, m_cutoff, m_quality, run.backend, run.precision,
+					     &run.enc_stats, &run.dec_stats, &progress, run.counters ? &run.enc_perf : nullptr,
+					     run.counters ? &run.dec_perf : nullptr);
+		    nsec_t ts_end = HTime_GetNsDelta(&ts);  // End timing
+		    run.elapsed_ns = static_cast<long double>(ts_end - ts_start);
+		    run.psnr = pending.psnrAgainst(from);
+		    if (run.precision != MYDCT_PRECISION_DOUBLE) {
+			ts_start = HTime_GetNsDelta(&ts);
+			run.psnr_double =
+			    pending.psnrAgainstDoubleOf(from, run.chunk_size, m_cutoff, m_quality, run.backend, &progress);
+			run.double_ns = static_cast<long double>(HTime_GetNsDelta(&ts) - ts_start);
+		    }
+		    run.kernel = codecPlan(run.backend, run.chunk_size)->getKernel();  // From the wisdom by now
+		});
+		snprintf((char*)&io_status_msg, 512, "Compressing in the background...");
+	    }
+	}
+	if (to_ready && !to.getEncoded().empty()) {
+	    ImGui::Separator();
+	    const CodecStats& enc_stats = shown.enc_stats;
+	    const CodecStats& dec_stats = shown.dec_stats;
+	    ImGui::Text("Encoded size: %zu bytes (%.2f:1, %.3f bits per pixel), PSNR: %.2f dB", enc_stats.encoded_bytes,
+			static_cast<double>(enc_stats.raw_bytes) / static_cast<double>(enc_stats.encoded_bytes),
+			8.0 * static_cast<double>(enc_stats.encoded_bytes) / static_cast<double>(enc_stats.raw_bytes),
+			shown.psnr);
+	    if (shown.precision != MYDCT_PRECISION_DOUBLE)
+		ImGui::Text("PSNR against the double precision path: %.2f dB", shown.psnr_double);
+	    ImGui::Text("Encoding (MB/s per thread): transform %.1f, quantization %.1f, entropy coding %.1f",
+			codecStageMBs(enc_stats, enc_stats.transform_ns), codecStageMBs(enc_stats, enc_stats.quantize_ns),
+			codecStageMBs(enc_stats, enc_stats.entropy_ns));
+	    ImGui::Text("Decoding (MB/s per thread): entropy decoding %.1f, dequantization %.1f, inverse transform %.1f",
+			codecStageMBs(dec_stats, dec_stats.entropy_ns), codecStageMBs(dec_stats, dec_stats.quantize_ns),
+			codecStageMBs(dec_stats, dec_stats.transform_ns));
+	    if (shown.counters) {
+		double pixels = std::max(static_cast<double>(enc_stats.raw_bytes), 1.0);
+		const PerfCounts* stages[] = {&shown.enc_perf, &shown.dec_perf};
+		const char* stage_names[] = {"Encoding", "Decoding"};
+		for (int i = 0; i < 2; i++) {
+		    PerfCounts per_pixel = stages[i]->per(pixels);
+		    ImGui::Text("%s: IPC %.2f; per pixel: %.1f instructions, %.3f L1D misses, %.4f LLC misses, %.3f branch "
+				"misses", stage_names[i], stages[i]->getIpc(), per_pixel.values[PERF_COUNTER_INSTRUCTIONS],
+				per_pixel.values[PERF_COUNTER_L1D_MISSES], per_pixel.values[PERF_COUNTER_LLC_MISSES],
+				per_pixel.values[PERF_COUNTER_BRANCH_MISSES]);
+		}
+		std::string missing;
+		for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+		    if (!shown.enc_perf.isValid(c)) missing += std::string(missing.empty() ? "" : ", ") + perfCounterName(c);
+		}
+		if (!missing.empty()) ImGui::Text("Not counted on this machine (shown as 0): %s", missing.c_str());
+	    }
+	    ImGui::InputText("##toPathTextBox", to_path, IM_ARRAYSIZE(to_path));
+	    ImGui::SameLine();
+	    if (ImGui::Button("Save Encoded Image")) {
+		try {
+		    codecSaveFile(to_path, to.getEncoded());
+		    snprintf((char*)&io_status_msg, 512, "Encoded image written to \"%s\".", to_path);
+		} catch (std::runtime_error& e) {
+		    snprintf((char*)&io_status_msg, 512, "Unable to write file \"%s\". Reason: %s", to_path, e.what());
+		}
 	    }
 	}
     }
@@ -249,7 +465,7 @@ void imgCompressorWindow(bool* visible) {
 	    ImGui::Text("Magnification (x100)");
 	    ImGui::Image((void*)(intptr_t)from.getTexture(), from_size);
 	    ImGui::Separator();
-	    ImGui::Text("Filename: %s", from.getPath().c_str());
+	    ImGui::Text("Filename: %s (%s)", from.getPath().c_str(), from.getSource());
 	    ImGui::Text("Width (px): %d, Height (px): %d", from.getWidth(), from.getHeight());
 	} else {
 	    ImGui::Text("Ready.");
@@ -37,6 +37,7 @@
 #define STBI_NO_PNM
 
 #include "imgui.h"
+#include "img_codec.h"
 
 void imgCompressorWindow(bool*);
 
@@ -25,6 +25,7 @@
 #include <SDL_opengl.h>
 
 #include <cstdio>
+#include <stdexcept>
 
 #include "imgui.h"
 #include "imgui_impl_opengl2.h"
@@ -34,6 +35,7 @@
 
 // DCTToolbox
 #include "dct_bench.h"
+#include "dct_plan.h"
 #include "img_compressor.h"
 #include "rnd_mat_gen.h"
 
@@ -83,6 +85,13 @@ int main(int argc, char** argv) {
     // Initialize the timebase
     HTime_InitBase();
 
+    // Pick up the plans measured by the previous runs
+    try {
+	dctPlanLoadWisdom(DCT_PLAN_WISDOM_FILE);
+    } catch (std::runtime_error& e) {
+	printf("Ignoring " DCT_PLAN_WISDOM_FILE ": %s\n", e.what());
+    }
+
     // Main loop
     bool done = false;
     while (!done) {
@@ -166,6 +175,15 @@ int main(int argc, char** argv) {
 	SDL_GL_SwapWindow(window);
     }
 
+    // Keep the plans for the next run
+    if (!dctPlanGetWisdom().empty()) {
+	try {
+	    dctPlanSaveWisdom(DCT_PLAN_WISDOM_FILE);
+	} catch (std::runtime_error& e) {
+	    printf("Unable to save " DCT_PLAN_WISDOM_FILE ": %s\n", e.what());
+	}
+    }
+
     // Cleanup
     ImGui_ImplOpenGL2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
@@ -0,0 +1,162 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "mat_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * @return MATFILE_LITTLE_ENDIAN or MATFILE_BIG_ENDIAN, for the machine we're running on.
+ */
+static int matFileNativeEndianness() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1 ? MATFILE_LITTLE_ENDIAN : MATFILE_BIG_ENDIAN;
+}
+
+/**
+ * Reverses the bytes of a value in place.
+ */
+static void matFileSwap(unsigned char* bytes, size_t size) {
+    std::reverse(bytes, bytes + size);
+}
+
+/**
+ * Reads an element (or a header field) stored with the given endianness.
+ */
+template <typename T>
+static T matFileRead(const unsigned char* src, int endianness) {
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, src, sizeof(T));
+    if (endianness != matFileNativeEndianness()) matFileSwap(bytes, sizeof(T));
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+/**
+ * Maps a matrix file and exposes its elements (see MatFileMapping).
+ * @param path The path of the file.
+ * @throws std::runtime_error If the file can't be mapped, is truncated or isn't a matrix file.
+ */
+MatFileMapping::MatFileMapping(const std::string& path)
+    : file(path), rows(0), cols(0), dtype(MATFILE_DTYPE_F64), data(nullptr) {
+    if (file.getLength() < MATFILE_HEADER_SIZE) throw std::runtime_error("Not a matrix file.");
+    const unsigned char* bytes = file.getBytes();
+    if (memcmp(bytes, MATFILE_MAGIC, 4) != 0) throw std::runtime_error("Not a matrix file.");
+    if (bytes[4] != MATFILE_VERSION) throw std::runtime_error("Unsupported matrix file version.");
+    dtype = bytes[5];
+    int endianness = bytes[6];
+    if (dtype != MATFILE_DTYPE_F64 && dtype != MATFILE_DTYPE_F32)
+	throw std::runtime_error("Unsupported element type in the matrix file.");
+    if (endianness != MATFILE_LITTLE_ENDIAN && endianness != MATFILE_BIG_ENDIAN)
+	throw std::runtime_error("Invalid endianness in the matrix file.");
+    uint32_t file_rows = matFileRead<uint32_t>(bytes + 8, endianness);
+    uint32_t file_cols = matFileRead<uint32_t>(bytes + 12, endianness);
+    if (file_rows == 0 || file_cols == 0 || file_rows > 0x7FFFFFFF || file_cols > 0x7FFFFFFF)
+	throw std::runtime_error("Invalid matrix size in the matrix file.");
+    size_t elem_size = dtype == MATFILE_DTYPE_F64 ? sizeof(double) : sizeof(float);
+    unsigned long long expected = MATFILE_HEADER_SIZE + static_cast<unsigned long long>(file_rows) * file_cols * elem_size;
+    if (expected != file.getLength()) throw std::runtime_error("The size of the matrix file doesn't match its header.");
+    rows = static_cast<int>(file_rows);
+    cols = static_cast<int>(file_cols);
+    const unsigned char* elems = bytes + MATFILE_HEADER_SIZE;
+    if (dtype == MATFILE_DTYPE_F64 && endianness == matFileNativeEndianness()) {
+	file.adviseWillNeed();
+	data = reinterpret_cast<const double*>(elems);
+	return;
+    }
+    file.adviseSequential();
+    size_t count = static_cast<size_t>(rows) * cols;
+    converted.resize(count);
+    for (size_t i = 0; i < count; i++) {
+	converted[i] = dtype == MATFILE_DTYPE_F64 ? matFileRead<double>(elems + i * elem_size, endianness)
+						  : matFileRead<float>(elems + i * elem_size, endianness);
+    }
+    file.unmap();
+    data = &converted.front();
+}
+
+/**
+ * @return Whether a path names a matrix file rather than a CSV one, going by its extension.
+ */
+bool matFileIsBinary(const std::string& path) {
+    size_t len = strlen(MATFILE_EXTENSION);
+    return path.size() > len && path.compare(path.size() - len, len, MATFILE_EXTENSION) == 0;
+}
+
+/**
+ * Reads a whole matrix file.
+ * @param path The path of the file.
+ * @param mat_rows Set to the number of rows of the matrix.
+ * @param mat_cols Set to the number of columns of the matrix.
+ * @return The elements, row by row.
+ * @throws std::runtime_error If the file can't be read or isn't a matrix file.
+ */
+std::vector<double> matFileImport(const std::string& path, int& mat_rows, int& mat_cols) {
+    MatFileMapping mapping(path);
+    mat_rows = mapping.getRows();
+    mat_cols = mapping.getCols();
+    return std::vector<double>(mapping.getData(), mapping.getData() + static_cast<size_t>(mat_rows) * mat_cols);
+}
+
+/**
+ * Writes a matrix file, with the endianness of the machine. The elements are written with a single call (converted first
+ * if they're to be stored as floats).
+ * @param path The path of the file.
+ * @param mat The elements, row by row.
+ * @param mat_rows The number of rows of the matrix.
+ * @param mat_cols The number of columns of the matrix.
+ * @param dtype How to store the elements: MATFILE_DTYPE_F64 or MATFILE_DTYPE_F32.
+ * @throws std::runtime_error If the sizes don't match or the file can't be written.
+ */
+void matFileExport(const std::string& path, const std::vector<double>& mat, int mat_rows, int mat_cols, int dtype) {
+    if (mat_rows <= 0 || mat_cols <= 0 || mat.size() != static_cast<size_t>(mat_rows) * mat_cols)
+	throw std::runtime_error("Can't interpret the contents of the vector as a matrix of the given size.");
+    if (dtype != MATFILE_DTYPE_F64 && dtype != MATFILE_DTYPE_F32) throw std::invalid_argument("Unknown element type.");
+    unsigned char header[MATFILE_HEADER_SIZE] = {};
+    memcpy(header, MATFILE_MAGIC, 4);
+    header[4] = MATFILE_VERSION;
+    header[5] = static_cast<unsigned char>(dtype);
+    header[6] = static_cast<unsigned char>(matFileNativeEndianness());
+    uint32_t dims[2] = {static_cast<uint32_t>(mat_rows), static_cast<uint32_t>(mat_cols)};
+    memcpy(header + 8, dims, sizeof(dims));
+    std::vector<float> narrowed;
+    const void* elems = &mat.front();
+    size_t elems_size = mat.size() * sizeof(double);
+    if (dtype == MATFILE_DTYPE_F32) {
+	narrowed.assign(mat.begin(), mat.end());
+	elems = &narrowed.front();
+	elems_size = narrowed.size() * sizeof(float);
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) throw std::runtime_error("An I/O error occurred while trying to open the file for writing.");
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) && fwrite(elems, 1, elems_size, file) == elems_size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) throw std::runtime_error("An I/O error occurred while writing the file.");
+}
@@ -0,0 +1,76 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_MAT_FILE_H
+#define PROJ2_MAT_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "file_mapping.h"
+
+/*
+ * A binary matrix format, for inputs and outputs too large to go through CSV files. A 16-byte header is followed by the
+ * elements, row by row, with no padding:
+ *   "DCTM" | version (u8) | dtype (u8) | endianness (u8, 0 little, 1 big) | reserved (u8) | rows (u32) | cols (u32)
+ * The header's integers and the elements are stored with the endianness given in the header, which is the one of the
+ * machine that wrote the file. Since the elements start at offset 16, doubles are aligned in a mapping of the file.
+ */
+#define MATFILE_MAGIC "DCTM"
+#define MATFILE_VERSION 1
+#define MATFILE_HEADER_SIZE 16
+#define MATFILE_EXTENSION ".dctm"
+
+#define MATFILE_DTYPE_F64 0
+#define MATFILE_DTYPE_F32 1
+
+#define MATFILE_LITTLE_ENDIAN 0
+#define MATFILE_BIG_ENDIAN 1
+
+/**
+ * A matrix file seen through a FileMapping. Doubles with the endianness of the machine (as written by matFileExport() on
+ * the same machine) are exposed in place; floats and swapped doubles are converted once into a buffer owned by the object.
+ */
+class MatFileMapping {
+   private:
+    FileMapping file;
+    int rows, cols, dtype;
+    const double* data;
+    std::vector<double> converted;  // The elements, if they can't be seen in place
+
+   public:
+    explicit MatFileMapping(const std::string& path);
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    int getDtype() const { return dtype; }
+    const double* getData() const { return data; }
+    bool isDirect() const { return converted.empty(); }
+};
+
+bool matFileIsBinary(const std::string&);
+std::vector<double> matFileImport(const std::string&, int&, int&);
+void matFileExport(const std::string&, const std::vector<double>&, int, int, int = MATFILE_DTYPE_F64);
+
+#endif  // PROJ2_MAT_FILE_H
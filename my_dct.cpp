@@ -28,6 +28,11 @@
  */
 
 #include "my_dct.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 #if MYDCT_TRANSPOSE_DEBUG
 #include <cstdio>
@@ -75,7 +80,7 @@ inline double MyDCTSum(const std::vector<double>& in, unsigned u, unsigned n) {
  * @param in The input vector.
  * @return A vector containing the DCT of the input.
  */
-std::vector<double> MyMDCT2(const std::vector<double>& in) {
+std::vector<double> MyMDCT2Naive(const std::vector<double>& in) {
     unsigned N = in.size();
     std::vector<double> out(N);
     for (unsigned u = 0; u < N; u++) {
@@ -85,29 +90,84 @@ std::vector<double> MyMDCT2(const std::vector<double>& in) {
 };
 
 /**
- * Transpose a matrix.
+ * Transposes a rows*cols matrix one MYDCT_TRANSPOSE_TILE-wide tile at a time, so that both the rows being read and the rows
+ * being written stay in cache even when the matrix doesn't.
+ * @param in The matrix to transpose, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The matrix that will hold the transposed (a cols*rows matrix, must not alias the input), whose rows are
+ * out_stride elements apart.
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the input matrix.
+ * @param cols The width of the input matrix.
+ */
+void MyDCTTransposeStrided(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows,
+			   unsigned cols) {
+    for (unsigned r0 = 0; r0 < rows; r0 += MYDCT_TRANSPOSE_TILE) {
+	unsigned r1 = std::min(r0 + MYDCT_TRANSPOSE_TILE, rows);
+	for (unsigned c0 = 0; c0 < cols; c0 += MYDCT_TRANSPOSE_TILE) {
+	    unsigned c1 = std::min(c0 + MYDCT_TRANSPOSE_TILE, cols);
+	    for (unsigned r = r0; r < r1; r++) {
+		for (unsigned c = c0; c < c1; c++) {
+		    out[c * out_stride + r] = in[r * in_stride + c];
+		}
+	    }
+	}
+    }
+}
+
+/**
+ * Transposes a contiguous rows*cols matrix, see MyDCTTransposeStrided().
  * @param in The matrix to transpose.
+ * @param out The matrix that will hold the transposed (a cols*rows matrix, must not alias the input).
+ * @param rows The height of the input matrix.
+ * @param cols The width of the input matrix.
+ */
+void MyDCTTransposeBlocked(const double* in, double* out, unsigned rows, unsigned cols) {
+    MyDCTTransposeStrided(in, cols, out, rows, rows, cols);
+}
+
+/**
+ * Transposes a square matrix in place, swapping tiles across the diagonal.
+ * @param mat The matrix to transpose.
  * @param n The width of the matrix.
- * @return The transposed of the input.
  */
-std::vector<double> MyDCTTranspose(const std::vector<double>& in, unsigned n) {
-    std::vector<double> out(n*n);
-    for (unsigned r = 0; r < n; r++) {      // u < height
-	for (unsigned c = 0; c < n; c++) {  // v < width
-	    out.at(c + (n * r)) = in.at(r + (n * c));
+void MyDCTTransposeInPlace(double* mat, unsigned n) {
+    for (unsigned r0 = 0; r0 < n; r0 += MYDCT_TRANSPOSE_TILE) {
+	unsigned r1 = std::min(r0 + MYDCT_TRANSPOSE_TILE, n);
+	for (unsigned c0 = r0; c0 < n; c0 += MYDCT_TRANSPOSE_TILE) {
+	    unsigned c1 = std::min(c0 + MYDCT_TRANSPOSE_TILE, n);
+	    for (unsigned r = r0; r < r1; r++) {
+		// On the diagonal tile only the upper triangle is swapped
+		for (unsigned c = (c0 == r0 ? r + 1 : c0); c < c1; c++) {
+		    std::swap(mat[static_cast<size_t>(r) * n + c], mat[static_cast<size_t>(c) * n + r]);
+		}
+	    }
 	}
     }
+}
+
+/**
+ * Transpose a matrix.
+ * @param in The matrix to transpose.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return The transposed of the input.
+ */
+std::vector<double> MyDCTTranspose(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyDCTTransposeBlocked(&in.front(), &out.front(), rows, cols);
 #if MYDCT_TRANSPOSE_DEBUG
-    for (unsigned r = 0; r < n; r++) {      // u < height
-	for (unsigned c = 0; c < n; c++) {  // v < width
-	    printf("%g\t", in.at(c + (n * r)));
+    for (unsigned r = 0; r < rows; r++) {
+	for (unsigned c = 0; c < cols; c++) {
+	    printf("%g\t", in.at(c + (cols * r)));
 	}
 	puts("");
     }
     puts("");
-    for (unsigned r = 0; r < n; r++) {      // u < height
-	for (unsigned c = 0; c < n; c++) {  // v < width
-	    printf("%g\t", out.at(c + (n * r)));
+    for (unsigned r = 0; r < cols; r++) {
+	for (unsigned c = 0; c < rows; c++) {
+	    printf("%g\t", out.at(c + (rows * r)));
 	}
 	puts("");
     }
@@ -115,17 +175,26 @@ std::vector<double> MyDCTTranspose(const std::vector<double>& in, unsigned n) {
     return out;
 }
 
+/**
+ * Transpose a square matrix.
+ * @param in The matrix to transpose.
+ * @param n The width of the matrix.
+ * @return The transposed of the input.
+ */
+std::vector<double> MyDCTTranspose(const std::vector<double>& in, unsigned n) { return MyDCTTranspose(in, n, n); }
+
 /**
  * Computes a single pass of DCT transform on rows.
  * @param in The matrix to perform the transform on.
- * @param n The height of the matrix (and its width, since it's square).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
  * @return The matrix containing the single-pass DCT transform of the input.
  */
-inline std::vector<double> MyDDCT2Pass(const std::vector<double>& in, unsigned n) {
-    std::vector<double> temp(n), out;
-    for (unsigned u = 0; u < n; u++) { // u < height
-	temp = {in.begin()+(n*u), in.begin()+n+(n*u)};
-	temp = MyMDCT2(temp);
+inline std::vector<double> MyDDCT2NaivePass(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> temp(cols), out;
+    for (unsigned u = 0; u < rows; u++) {
+	temp = {in.begin()+(cols*u), in.begin()+cols+(cols*u)};
+	temp = MyMDCT2Naive(temp);
 	out.insert(out.end(), temp.begin(), temp.end());
     }
     return out;
@@ -134,20 +203,520 @@ inline std::vector<double> MyDDCT2Pass(const std::vector<double>& in, unsigned n
 /**
  * Due to a property known as "separability", a multi-dimensional DCT2 can be implemented as the product of its mono-dimensional
  * steps. This property allows us to considerably reduce the processing time, confronted with the "dumb" version (not
- * implemented here).
+ * implemented here). The rows are transformed first, then the matrix is transposed so that its columns can be transformed
+ * as rows, and transposed back.
+ * @param in The input vector (a rows*cols matrix).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyDDCT2Naive(const std::vector<double>& in, unsigned rows, unsigned cols) {
+#if MYDCT_DDCT2_DEBUG
+    // assuming in is a matrix, ensure the size is correct
+    assert(in.size() == rows * cols);
+#endif
+    std::vector<double> out;
+    out = MyDCTTranspose(MyDDCT2NaivePass(in, rows, cols), rows, cols);
+    out = MyDCTTranspose(MyDDCT2NaivePass(out, cols, rows), cols, rows);
+    // rows*cols*(rows+cols), n^3 for square matrices
+    return out;
+}
+
+/**
+ * Square version of MyDDCT2Naive().
  * @param in The input vector (a n*n matrix).
  * @param n The height of the matrix (and its width, since it's square).
  * @return A vector containing the DCT of the input (a n*n matrix).
  */
-std::vector<double> MyDDCT2(const std::vector<double>& in, unsigned n) {
+std::vector<double> MyDDCT2Naive(const std::vector<double>& in, unsigned n) { return MyDDCT2Naive(in, n, n); }
+
+/*
+ * Basis tables
+ *
+ * Both MyDCTCoeff() and the cosine in MyDCTSum() only depend on the waveform index, the sample index and the width of the
+ * input, so the whole n*n matrix of scaled cosines can be built once and reused for every row (and every call) of the same
+ * width. The tables are kept in a process-wide cache whose footprint is bounded by MYDCT_BASIS_CACHE_BUDGET: when a new table
+ * would overflow the budget, the least recently used ones are evicted. Evicted tables stay alive for as long as a caller holds
+ * a reference to them.
+ */
+
+struct MyDCTBasisCacheEntry {
+    std::shared_ptr<const MyDCTBasis> basis;
+    unsigned long last_use;
+};
+
+static std::mutex basis_cache_mtx;
+static std::map<unsigned, MyDCTBasisCacheEntry> basis_cache;
+static size_t basis_cache_bytes = 0;
+static unsigned long basis_cache_clock = 0;
+
+/**
+ * Builds the basis table for a n-wide transform using the same expressions as the naive implementation, so that each entry
+ * is exactly MyDCTCoeff(u, n) times the cosine that MyDCTSum() would have computed.
+ * @param n The width of the transform.
+ * @return The newly allocated basis.
+ */
+static std::shared_ptr<const MyDCTBasis> MyDCTBuildBasis(unsigned n) {
+    std::shared_ptr<MyDCTBasis> basis = std::make_shared<MyDCTBasis>();
+    basis->n = n;
+    basis->table.resize(static_cast<size_t>(n) * n);
+    basis->transposed.resize(basis->table.size());
+    for (unsigned u = 0; u < n; u++) {
+	double coeff = MyDCTCoeff(u, n);
+	for (unsigned x = 0; x < n; x++) {
+	    basis->table[u * n + x] = coeff * cos((M_PI * (2 * x + 1) * u) / (2 * n));
+	    basis->transposed[x * n + u] = basis->table[u * n + x];
+	}
+    }
+    return basis;
+}
+
+static inline size_t MyDCTBasisBytes(unsigned n) { return 2 * static_cast<size_t>(n) * n * sizeof(double); }
+
+/**
+ * Retrieves the basis table for a n-wide transform, building it on the first request. Safe to call from multiple threads.
+ * Tables that don't fit in MYDCT_BASIS_CACHE_BUDGET on their own are handed out without being cached.
+ * @param n The width of the transform.
+ * @return A shared reference to the basis.
+ */
+std::shared_ptr<const MyDCTBasis> MyDCTGetBasis(unsigned n) {
+    {
+	std::lock_guard<std::mutex> lock(basis_cache_mtx);
+	auto it = basis_cache.find(n);
+	if (it != basis_cache.end()) {
+	    it->second.last_use = ++basis_cache_clock;
+	    return it->second.basis;
+	}
+    }
+    // Build outside of the lock: large tables take a while and other widths shouldn't wait for them
+    std::shared_ptr<const MyDCTBasis> basis = MyDCTBuildBasis(n);
+    size_t bytes = MyDCTBasisBytes(n);
+    if (bytes > MYDCT_BASIS_CACHE_BUDGET) return basis;
+    std::lock_guard<std::mutex> lock(basis_cache_mtx);
+    auto it = basis_cache.find(n);
+    if (it != basis_cache.end()) {  // Somebody else beat us to it
+	it->second.last_use = ++basis_cache_clock;
+	return it->second.basis;
+    }
+    while (basis_cache_bytes + bytes > MYDCT_BASIS_CACHE_BUDGET) {
+	auto lru = basis_cache.begin();
+	for (auto cur = basis_cache.begin(); cur != basis_cache.end(); cur++) {
+	    if (cur->second.last_use < lru->second.last_use) lru = cur;
+	}
+	basis_cache_bytes -= MyDCTBasisBytes(lru->first);
+	basis_cache.erase(lru);
+    }
+    basis_cache[n] = {basis, ++basis_cache_clock};
+    basis_cache_bytes += bytes;
+    return basis;
+}
+
+/**
+ * @return The amount of memory (in bytes) currently held by the basis cache.
+ */
+size_t MyDCTBasisCacheSize() {
+    std::lock_guard<std::mutex> lock(basis_cache_mtx);
+    return basis_cache_bytes;
+}
+
+/**
+ * Drops every table from the basis cache.
+ */
+void MyDCTFlushBasisCache() {
+    std::lock_guard<std::mutex> lock(basis_cache_mtx);
+    basis_cache.clear();
+    basis_cache_bytes = 0;
+}
+
+/**
+ * Computes a single output of the transform as the dot product between a row of the basis and the input samples.
+ * @param basis_row The u-th row of the basis table.
+ * @param in The input samples.
+ * @param n The input's width.
+ * @return The u-th coefficient of the transform.
+ */
+static inline double MyDCTDot(const double* basis_row, const double* in, unsigned n) {
+    double sum = .0f;
+    for (unsigned x = 0; x < n; x++) {
+	sum += basis_row[x] * in[x];
+    }
+    return sum;
+}
+
+/**
+ * Implements a mono-dimensional DCT2 transform as n dot products against the cached basis table for the input's width: no
+ * transcendental function is evaluated once the table has been built. The result matches MyMDCT2Naive() within rounding: since
+ * the coefficient is folded into the table instead of being applied to the sum, each output differs by at most
+ * n * DBL_EPSILON * sum(|in(x)|), which is well below the precision of the printed results.
+ * @param in The input samples, in_stride elements apart.
+ * @param in_stride The distance between two consecutive input samples.
+ * @param out The output coefficients, out_stride elements apart (may alias the input).
+ * @param out_stride The distance between two consecutive output coefficients.
+ * @param n The input's width.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyMDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n, MyDCTWorkspace* ws) {
+    if (n == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& basis = MyDCTWorkspaceBasis(ws->row_basis, n);
+    double* x = MyDCTWorkspaceBuffer(ws->step, n);
+    for (unsigned i = 0; i < n; i++) x[i] = in[i * in_stride];
+    for (unsigned u = 0; u < n; u++) {
+	out[u * out_stride] = MyDCTDot(&basis.table[u * n], x, n);
+    }
+}
+
+/**
+ * Vector-based front end for MyMDCT2().
+ * @param in The input vector.
+ * @return A vector containing the DCT of the input.
+ */
+std::vector<double> MyMDCT2(const std::vector<double>& in) {
+    std::vector<double> out(in.size());
+    if (out.empty()) return out;
+    MyMDCT2(&in.front(), 1, &out.front(), 1, in.size());
+    return out;
+}
+
+/**
+ * Computes a single pass of table-driven DCT transform on the rows of a matrix.
+ * @param in The matrix to perform the transform on, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The contiguous matrix that will hold the result (must not alias the input).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param basis The basis table for a cols-wide transform.
+ */
+static inline void MyDDCT2Pass(const double* in, ptrdiff_t in_stride, double* out, unsigned rows, unsigned cols,
+			       const MyDCTBasis& basis) {
+    for (unsigned r = 0; r < rows; r++) {  // r < height
+	const double* in_row = &in[r * in_stride];
+	double* out_row = &out[static_cast<size_t>(r) * cols];
+	for (unsigned u = 0; u < cols; u++) {
+	    out_row[u] = MyDCTDot(&basis.table[u * cols], in_row, cols);
+	}
+    }
+}
+
+/**
+ * Computes a single pass of table-driven DCT transform on the columns of a matrix without transposing it: each output row is
+ * accumulated from whole input rows, scaled by the matching entry of the basis. The additions happen in the same order as in
+ * MyDDCT2Pass(), so the result is the same as transposing, running a row pass and transposing back.
+ * @param in The contiguous matrix to perform the transform on.
+ * @param out The matrix that will hold the result, whose rows are out_stride elements apart (must not alias the input).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param basis The basis table for a rows-wide transform.
+ * @param first The first output row to compute.
+ * @param last The output row to stop at (excluded).
+ */
+static inline void MyDDCT2ColPass(const double* in, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+				  const MyDCTBasis& basis, unsigned first, unsigned last) {
+    for (unsigned v = first; v < last; v++) {
+	double* out_row = &out[v * out_stride];
+	const double* basis_row = &basis.table[v * rows];
+	for (unsigned c = 0; c < cols; c++) out_row[c] = .0f;
+	for (unsigned y = 0; y < rows; y++) {
+	    const double* in_row = &in[static_cast<size_t>(y) * cols];
+	    double coeff = basis_row[y];
+	    for (unsigned c = 0; c < cols; c++) {
+		out_row[c] += coeff * in_row[c];
+	    }
+	}
+    }
+}
+
+/**
+ * Table-driven version of the separable multi-dimensional DCT2: a pass on the rows followed by one on the columns, neither of
+ * which requires transposing the matrix. The cost is rows*cols*(rows+cols) multiply-adds with no transcendental calls, and no
+ * memory is allocated when a workspace that has already been used for a matrix of the same size is provided. Same tolerance
+ * as MyMDCT2() applies.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyDDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+	     MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    MyDDCT2Pass(in, in_stride, step, rows, cols, row_basis);
+    MyDDCT2ColPass(step, out, out_stride, rows, cols, col_basis, 0, rows);
+}
+
+/**
+ * Vector-based front end for MyDDCT2().
+ * @param in The input vector (a rows*cols matrix).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyDDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
 #if MYDCT_DDCT2_DEBUG
-    // assuming in is a matrix, ensure the size is correct
-    unsigned N = n * n;  // we only support square matrices, thus width = height
-    assert(in.size() == N);
+    assert(in.size() == rows * cols);
 #endif
-    std::vector<double> step, out;
-    out = MyDCTTranspose(MyDDCT2Pass(in, n), n);
-    out = MyDCTTranspose(MyDDCT2Pass(out, n), n);
-    // n*n*(2*n)~=n^3
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyDDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
     return out;
-}
\ No newline at end of file
+}
+
+/**
+ * Vector-based front end for MyDDCT2(), for square matrices.
+ * @param in The input vector (a n*n matrix).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the DCT of the input (a n*n matrix).
+ */
+std::vector<double> MyDDCT2(const std::vector<double>& in, unsigned n) { return MyDDCT2(in, n, n); }
+
+/**
+ * Implements a mono-dimensional DCT3 transform (the inverse of MyMDCT2()) using the same basis table as the forward transform,
+ * read column-wise: out(x) = sum(alpha(u) * cos(pi * (2x + 1) * u / 2n) * in(u)). Same tolerance as MyMDCT2() applies.
+ * @param in The input coefficients, in_stride elements apart.
+ * @param in_stride The distance between two consecutive input coefficients.
+ * @param out The output samples, out_stride elements apart (may alias the input).
+ * @param out_stride The distance between two consecutive output samples.
+ * @param n The input's width.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyMIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n, MyDCTWorkspace* ws) {
+    if (n == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& basis = MyDCTWorkspaceBasis(ws->row_basis, n);
+    double* X = MyDCTWorkspaceBuffer(ws->step, n);
+    double* x = MyDCTWorkspaceBuffer(ws->step2, n);
+    for (unsigned u = 0; u < n; u++) {
+	X[u] = in[u * in_stride];
+	x[u] = .0f;
+    }
+    for (unsigned u = 0; u < n; u++) {
+	const double* basis_row = &basis.table[u * n];
+	for (unsigned i = 0; i < n; i++) {
+	    x[i] += X[u] * basis_row[i];
+	}
+    }
+    for (unsigned i = 0; i < n; i++) out[i * out_stride] = x[i];
+}
+
+/**
+ * Vector-based front end for MyMIDCT2().
+ * @param in The input vector (the DCT coefficients).
+ * @return A vector containing the inverse DCT of the input.
+ */
+std::vector<double> MyMIDCT2(const std::vector<double>& in) {
+    std::vector<double> out(in.size());
+    if (out.empty()) return out;
+    MyMIDCT2(&in.front(), 1, &out.front(), 1, in.size());
+    return out;
+}
+
+/**
+ * Computes a single pass of table-driven inverse DCT transform on the rows of a matrix.
+ * @param in The matrix to perform the transform on, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The contiguous matrix that will hold the result (must not alias the input).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param basis The basis table for a cols-wide transform.
+ */
+static inline void MyDIDCT2Pass(const double* in, ptrdiff_t in_stride, double* out, unsigned rows, unsigned cols,
+				const MyDCTBasis& basis) {
+    for (unsigned r = 0; r < rows; r++) {  // r < height
+	const double* in_row = &in[r * in_stride];
+	double* out_row = &out[static_cast<size_t>(r) * cols];
+	for (unsigned x = 0; x < cols; x++) out_row[x] = .0f;
+	for (unsigned u = 0; u < cols; u++) {
+	    const double* basis_row = &basis.table[u * cols];
+	    double coeff = in_row[u];
+	    for (unsigned x = 0; x < cols; x++) {
+		out_row[x] += coeff * basis_row[x];
+	    }
+	}
+    }
+}
+
+/**
+ * Computes a single pass of table-driven inverse DCT transform on the columns of a matrix without transposing it.
+ * @param in The contiguous matrix to perform the transform on.
+ * @param out The matrix that will hold the result, whose rows are out_stride elements apart (must not alias the input).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param basis The basis table for a rows-wide transform.
+ * @param first The first output row to compute.
+ * @param last The output row to stop at (excluded).
+ */
+static inline void MyDIDCT2ColPass(const double* in, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+				   const MyDCTBasis& basis, unsigned first, unsigned last) {
+    for (unsigned y = first; y < last; y++) {
+	double* out_row = &out[y * out_stride];
+	for (unsigned c = 0; c < cols; c++) out_row[c] = .0f;
+	for (unsigned v = 0; v < rows; v++) {
+	    const double* in_row = &in[static_cast<size_t>(v) * cols];
+	    double coeff = basis.table[v * rows + y];
+	    for (unsigned c = 0; c < cols; c++) {
+		out_row[c] += coeff * in_row[c];
+	    }
+	}
+    }
+}
+
+/**
+ * Table-driven separable multi-dimensional DCT3, the inverse of MyDDCT2(). Same considerations about the workspace apply.
+ * @param in The input matrix of DCT coefficients, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyDIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+	      MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    MyDIDCT2Pass(in, in_stride, step, rows, cols, row_basis);
+    MyDIDCT2ColPass(step, out, out_stride, rows, cols, col_basis, 0, rows);
+}
+
+/**
+ * Vector-based front end for MyDIDCT2().
+ * @param in The input vector (the rows*cols matrix of DCT coefficients).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the inverse DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyDIDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
+#if MYDCT_DDCT2_DEBUG
+    assert(in.size() == rows * cols);
+#endif
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyDIDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for MyDIDCT2(), for square matrices.
+ * @param in The input vector (the n*n matrix of DCT coefficients).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the inverse DCT of the input (a n*n matrix).
+ */
+std::vector<double> MyDIDCT2(const std::vector<double>& in, unsigned n) { return MyDIDCT2(in, n, n); }
+
+/*
+ * Parallel table-driven transforms.
+ *
+ * Both passes are split in bands of rows, spread across a thread pool, with a barrier in between (the column pass needs
+ * every row of the intermediate matrix). Each output element is computed by exactly one thread, with the same operations in
+ * the same order as the single-threaded path, so the results are bit-for-bit identical to MyDDCT2() and MyDIDCT2() whatever
+ * the number of threads.
+ */
+
+/**
+ * Multithreaded version of MyDDCT2(). Matrices smaller than MYDCT_PARALLEL_MIN_ELEMS are transformed on the calling thread.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param pool The pool to run on, or nullptr to use the shared one.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyParallelDDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		     ThreadPool* pool, MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    if (static_cast<size_t>(rows) * cols < MYDCT_PARALLEL_MIN_ELEMS) {
+	MyDDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	return;
+    }
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    if (pool == nullptr) pool = &getSharedThreadPool();
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    pool->parallelFor(0, rows, [&](size_t first, size_t last) {
+	MyDDCT2Pass(&in[first * in_stride], in_stride, &step[first * cols], last - first, cols, row_basis);
+    });
+    pool->parallelFor(0, rows, [&](size_t first, size_t last) {
+	MyDDCT2ColPass(step, out, out_stride, rows, cols, col_basis, first, last);
+    });
+}
+
+/**
+ * Vector-based front end for MyParallelDDCT2().
+ * @param in The input vector (a rows*cols matrix).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param pool The pool to run on, or nullptr to use the shared one.
+ * @return A vector containing the DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyParallelDDCT2(const std::vector<double>& in, unsigned rows, unsigned cols, ThreadPool* pool) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyParallelDDCT2(&in.front(), cols, &out.front(), cols, rows, cols, pool);
+    return out;
+}
+
+/**
+ * Multithreaded version of MyDIDCT2(). Same considerations as MyParallelDDCT2() apply.
+ * @param in The input matrix of DCT coefficients, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param pool The pool to run on, or nullptr to use the shared one.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyParallelDIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		      ThreadPool* pool, MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    if (static_cast<size_t>(rows) * cols < MYDCT_PARALLEL_MIN_ELEMS) {
+	MyDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+	return;
+    }
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    if (pool == nullptr) pool = &getSharedThreadPool();
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    pool->parallelFor(0, rows, [&](size_t first, size_t last) {
+	MyDIDCT2Pass(&in[first * in_stride], in_stride, &step[first * cols], last - first, cols, row_basis);
+    });
+    pool->parallelFor(0, rows, [&](size_t first, size_t last) {
+	MyDIDCT2ColPass(step, out, out_stride, rows, cols, col_basis, first, last);
+    });
+}
+
+/**
+ * Vector-based front end for MyParallelDIDCT2().
+ * @param in The input vector (the rows*cols matrix of DCT coefficients).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param pool The pool to run on, or nullptr to use the shared one.
+ * @return A vector containing the inverse DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyParallelDIDCT2(const std::vector<double>& in, unsigned rows, unsigned cols, ThreadPool* pool) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyParallelDIDCT2(&in.front(), cols, &out.front(), cols, rows, cols, pool);
+    return out;
+}
@@ -27,11 +27,139 @@
 #define MYDCT_TRANSPOSE_DEBUG 0
 #define MYDCT_DDCT2_DEBUG 0
 
+// Side of the square tiles used by the blocked transpose (two tiles of doubles fit comfortably in L1)
+#define MYDCT_TRANSPOSE_TILE 32u
+
+// Upper bound (in bytes) for the memory held by the cache of basis tables
+#define MYDCT_BASIS_CACHE_BUDGET (32u * 1024u * 1024u)
+
+// Matrices with fewer elements than this are not worth waking up the thread pool for
+#define MYDCT_PARALLEL_MIN_ELEMS 4096u
+
+// Instruction sets the SIMD kernels can be dispatched to
+#define MYDCT_ISA_SCALAR 0
+#define MYDCT_ISA_SSE2 1
+#define MYDCT_ISA_AVX2 2
+#define MYDCT_ISA_AVX512 3
+
+// Layouts of the blocks handed to the batched transforms
+#define MYDCT_LAYOUT_INTERLEAVED 0  // Each block whole, one after the other
+#define MYDCT_LAYOUT_SOA 1          // Element i of block k at i * blocks + k
+
+// How many blocks the batched transforms process at once
+#define MYDCT_BATCH_LANES 32u
+
 #include <cmath>
+#include <complex>
+#include <cstddef>
 #include <cstdlib>
+#include <memory>
 #include <vector>
 
+/**
+ * Holds the scaled cosine matrix of a n-wide DCT-II, laid out so that the u-th waveform is stored in the u-th row:
+ * table[u * n + x] = alpha(u) * cos(pi * (2x + 1) * u / 2n). The transposed matrix is kept alongside it for the kernels that
+ * need to walk the waveforms column-wise.
+ */
+struct MyDCTBasis {
+    unsigned n;
+    std::vector<double> table;
+    std::vector<double> transposed;
+};
+
+std::shared_ptr<const MyDCTBasis> MyDCTGetBasis(unsigned);
+size_t MyDCTBasisCacheSize();
+void MyDCTFlushBasisCache();
+
+struct MyFastDCTPlan;  // my_dct_fast.cpp
+class ThreadPool;     // thread_pool.h
+
+/**
+ * Scratch memory and cached tables for the pointer-based transforms. Buffers only ever grow and the tables are only looked up
+ * again when the size of the transform changes, so a workspace that is reused for transforms of the same size makes them
+ * allocation-free (and lock-free) after the first call. A workspace must not be shared between threads.
+ */
+struct MyDCTWorkspace {
+    std::shared_ptr<const MyDCTBasis> row_basis, col_basis;
+    std::shared_ptr<const MyFastDCTPlan> row_plan, col_plan;
+    std::vector<double> step, step2;
+    std::vector<std::complex<double>> fft_in, fft_out;
+};
+
+/**
+ * Grows a workspace buffer to (at least) the given size.
+ * @param buf The buffer.
+ * @param size The number of elements needed.
+ * @return A pointer to the first element of the buffer.
+ */
+template <typename T>
+inline T* MyDCTWorkspaceBuffer(std::vector<T>& buf, size_t size) {
+    if (buf.size() < size) buf.resize(size);
+    return &buf.front();
+}
+
+/**
+ * Retrieves the basis table for a n-wide transform, only hitting the cache if the one held by the workspace has a different
+ * width.
+ * @param slot The workspace's reference to the basis.
+ * @param n The width of the transform.
+ * @return The basis.
+ */
+inline const MyDCTBasis& MyDCTWorkspaceBasis(std::shared_ptr<const MyDCTBasis>& slot, unsigned n) {
+    if (!slot || slot->n != n) slot = MyDCTGetBasis(n);
+    return *slot;
+}
+
+void MyMDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, MyDCTWorkspace* = nullptr);
+void MyDDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
+void MyMIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, MyDCTWorkspace* = nullptr);
+void MyDIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
 std::vector<double> MyMDCT2(const std::vector<double>&);
 std::vector<double> MyDDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MyDDCT2(const std::vector<double>&, unsigned, unsigned);
+std::vector<double> MyMIDCT2(const std::vector<double>&);
+std::vector<double> MyDIDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MyDIDCT2(const std::vector<double>&, unsigned, unsigned);
+std::vector<double> MyMDCT2Naive(const std::vector<double>&);
+std::vector<double> MyDDCT2Naive(const std::vector<double>&, unsigned);
+std::vector<double> MyDDCT2Naive(const std::vector<double>&, unsigned, unsigned);
+void MyDCTTransposeStrided(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned);
+void MyDCTTransposeBlocked(const double*, double*, unsigned, unsigned);
+void MyDCTTransposeInPlace(double*, unsigned);
+std::vector<double> MyDCTTranspose(const std::vector<double>&, unsigned);
+std::vector<double> MyDCTTranspose(const std::vector<double>&, unsigned, unsigned);
+void MyParallelDDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, ThreadPool* = nullptr,
+		     MyDCTWorkspace* = nullptr);
+void MyParallelDIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, ThreadPool* = nullptr,
+		      MyDCTWorkspace* = nullptr);
+std::vector<double> MyParallelDDCT2(const std::vector<double>&, unsigned, unsigned, ThreadPool* = nullptr);
+std::vector<double> MyParallelDIDCT2(const std::vector<double>&, unsigned, unsigned, ThreadPool* = nullptr);
+
+// my_dct_fast.cpp
+bool MyFastDCTSupports(unsigned);
+void MyFastMDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, MyDCTWorkspace* = nullptr);
+void MyFastDDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
+void MyFastMIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, MyDCTWorkspace* = nullptr);
+void MyFastDIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
+std::vector<double> MyFastMDCT2(const std::vector<double>&);
+std::vector<double> MyFastDDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MyFastDDCT2(const std::vector<double>&, unsigned, unsigned);
+std::vector<double> MyFastMIDCT2(const std::vector<double>&);
+std::vector<double> MyFastDIDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MyFastDIDCT2(const std::vector<double>&, unsigned, unsigned);
+
+// my_dct_simd.cpp
+int MyDCTSimdDetectIsa();
+void MyDCTSimdForceIsa(int);
+int MyDCTSimdActiveIsa();
+const char* MyDCTSimdIsaName(int);
+void MySimdDDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
+void MySimdDIDCT2(const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned, MyDCTWorkspace* = nullptr);
+std::vector<double> MySimdDDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MySimdDDCT2(const std::vector<double>&, unsigned, unsigned);
+std::vector<double> MySimdDIDCT2(const std::vector<double>&, unsigned);
+std::vector<double> MySimdDIDCT2(const std::vector<double>&, unsigned, unsigned);
+void MyBatchDDCT2(const double*, double*, unsigned, size_t, int, MyDCTWorkspace* = nullptr);
+void MyBatchDIDCT2(const double*, double*, unsigned, size_t, int, MyDCTWorkspace* = nullptr);
 
 #endif  // PROJ2_MY_DCT_H
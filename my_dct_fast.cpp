@@ -0,0 +1,417 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+/* Fast DCT-II, computed through a complex FFT of the same length as the input using Makhoul's reordering:
+ * J. Makhoul, "A fast cosine transform in one and multiple dimensions", IEEE Trans. ASSP, 1980.
+ * v(k) -> reordered input (even samples first, then the odd ones reversed)
+ * V(u) -> FFT of v
+ * C(u) = alpha(u) * Re(exp(-i*pi*u/2N) * V(u))
+ * The inverse (DCT-III) walks the same steps backwards: since v is real, V(u) can be rebuilt from C(u) and C(N-u) alone, then
+ * v = IFFT(V) = Re(FFT(conj(V))) / N is put back in the original order.
+ */
+
+#include <algorithm>
+#include <complex>
+#include <map>
+#include <mutex>
+
+#include "my_dct.h"
+
+typedef std::complex<double> MyComplex;
+
+/**
+ * Everything that only depends on the width of the transform: the radix decomposition of n, the FFT twiddles, the
+ * post-processing twiddles of the DCT (already scaled by alpha(u)) and the pre-processing twiddles of the inverse (already
+ * scaled by 1 / (n * alpha(u))).
+ */
+struct MyFastDCTPlan {
+    unsigned n;
+    std::vector<unsigned> factors;  // (radix, remaining length) pairs
+    std::vector<MyComplex> twiddles;
+    std::vector<MyComplex> post;
+    std::vector<MyComplex> inv_pre;
+};
+
+static std::mutex fast_plan_mtx;
+static std::map<unsigned, std::shared_ptr<const MyFastDCTPlan>> fast_plans;
+
+/**
+ * Decomposes n in its radices, largest power of two first.
+ * @param n The length of the FFT.
+ * @param factors Filled with (radix, remaining length) pairs.
+ * @return Whether n could be factored using the supported radices (2, 3, 5 and 7).
+ */
+static bool MyFFTFactor(unsigned n, std::vector<unsigned>& factors) {
+    static const unsigned radices[] = {2, 3, 5, 7};
+    factors.clear();
+    for (unsigned p : radices) {
+	while (n % p == 0) {
+	    n /= p;
+	    factors.push_back(p);
+	    factors.push_back(n);
+	}
+    }
+    return n == 1;
+}
+
+/**
+ * @param n The width of the transform.
+ * @return Whether MyFastMDCT2() and MyFastDDCT2() can use the fast path for inputs of this width (i.e. n only has 2, 3, 5 and
+ * 7 as prime factors). Other widths silently fall back to the table-driven transforms.
+ */
+bool MyFastDCTSupports(unsigned n) {
+    static const unsigned radices[] = {2, 3, 5, 7};
+    if (n == 0) return false;
+    for (unsigned p : radices) {
+	while (n % p == 0) n /= p;
+    }
+    return n == 1;
+}
+
+static std::shared_ptr<const MyFastDCTPlan> MyFastDCTGetPlan(unsigned n) {
+    std::lock_guard<std::mutex> lock(fast_plan_mtx);
+    auto it = fast_plans.find(n);
+    if (it != fast_plans.end()) return it->second;
+    std::shared_ptr<MyFastDCTPlan> plan = std::make_shared<MyFastDCTPlan>();
+    plan->n = n;
+    MyFFTFactor(n, plan->factors);
+    plan->twiddles.resize(n);
+    plan->post.resize(n);
+    plan->inv_pre.resize(n);
+    for (unsigned k = 0; k < n; k++) {
+	double coeff = k == 0 ? sqrt(1 / (double)n) : sqrt(2 / (double)n);
+	plan->twiddles[k] = std::polar(1.0, -2 * M_PI * k / n);
+	plan->post[k] = std::polar(coeff, -M_PI * k / (2 * n));
+	plan->inv_pre[k] = std::polar(1 / (coeff * n), -M_PI * k / (2 * n));
+    }
+    fast_plans[n] = plan;
+    return plan;
+}
+
+/**
+ * Retrieves the plan for a n-wide transform, only hitting the cache if the one held by the workspace has a different width.
+ * @param slot The workspace's reference to the plan.
+ * @param n The width of the transform.
+ * @return The plan.
+ */
+static inline const MyFastDCTPlan& MyFastDCTWorkspacePlan(std::shared_ptr<const MyFastDCTPlan>& slot, unsigned n) {
+    if (!slot || slot->n != n) slot = MyFastDCTGetPlan(n);
+    return *slot;
+}
+
+/**
+ * Radix-2 butterfly of the decimation-in-time FFT.
+ */
+static inline void MyFFTButterfly2(MyComplex* out, size_t fstride, const MyFastDCTPlan& plan, unsigned m) {
+    MyComplex* out2 = out + m;
+    for (unsigned k = 0; k < m; k++) {
+	MyComplex t = out2[k] * plan.twiddles[k * fstride];
+	out2[k] = out[k] - t;
+	out[k] += t;
+    }
+}
+
+/**
+ * Generic radix-p butterfly of the decimation-in-time FFT, O(p^2) per group: only used for the small odd radices.
+ */
+static inline void MyFFTButterflyGeneric(MyComplex* out, size_t fstride, const MyFastDCTPlan& plan, unsigned m, unsigned p) {
+    MyComplex scratch[7];
+    for (unsigned u = 0; u < m; u++) {
+	for (unsigned q = 0, k = u; q < p; q++, k += m) scratch[q] = out[k];
+	for (unsigned q = 0, k = u; q < p; q++, k += m) {
+	    size_t tw = 0;
+	    out[k] = scratch[0];
+	    for (unsigned j = 1; j < p; j++) {
+		tw += fstride * k;
+		if (tw >= plan.n) tw -= plan.n;
+		out[k] += scratch[j] * plan.twiddles[tw];
+	    }
+	}
+    }
+}
+
+/**
+ * Recursive mixed-radix FFT (decimation in time).
+ * @param out The output sequence (must not alias the input).
+ * @param in The input sequence.
+ * @param fstride The distance between consecutive samples of the current sub-sequence, in units of the input.
+ * @param factors The remaining (radix, length) pairs.
+ * @param plan The plan of the full-length transform.
+ */
+static void MyFFTWork(MyComplex* out, const MyComplex* in, size_t fstride, const unsigned* factors, const MyFastDCTPlan& plan) {
+    unsigned p = factors[0], m = factors[1];
+    MyComplex* out_end = out + p * m;
+    if (m == 1) {
+	for (MyComplex* cur = out; cur != out_end; cur++, in += fstride) *cur = *in;
+    } else {
+	for (MyComplex* cur = out; cur != out_end; cur += m, in += fstride) MyFFTWork(cur, in, fstride * p, factors + 2, plan);
+    }
+    if (p == 2)
+	MyFFTButterfly2(out, fstride, plan, m);
+    else
+	MyFFTButterflyGeneric(out, fstride, plan, m, p);
+}
+
+/**
+ * Computes the fast DCT-II of a single row.
+ * @param in The input row.
+ * @param out The output row (may alias the input).
+ * @param plan The plan for the row's width.
+ * @param v Scratch buffer of plan.n elements holding the reordered input.
+ * @param V Scratch buffer of plan.n elements holding its FFT.
+ */
+static void MyFastDCTRow(const double* in, double* out, const MyFastDCTPlan& plan, MyComplex* v, MyComplex* V) {
+    unsigned n = plan.n;
+    for (unsigned x = 0; x < n; x++) {
+	if (x % 2 == 0)
+	    v[x / 2] = in[x];
+	else
+	    v[n - 1 - x / 2] = in[x];
+    }
+    if (n == 1)
+	V[0] = v[0];
+    else
+	MyFFTWork(V, v, 1, &plan.factors.front(), plan);
+    for (unsigned u = 0; u < n; u++) {
+	out[u] = (plan.post[u] * V[u]).real();
+    }
+}
+
+/**
+ * Computes the fast DCT-III (inverse DCT-II) of a single row.
+ * @param in The input row (the DCT coefficients).
+ * @param out The output row (may alias the input).
+ * @param plan The plan for the row's width.
+ * @param V Scratch buffer of plan.n elements holding the rebuilt (conjugated) spectrum.
+ * @param v Scratch buffer of plan.n elements holding its FFT.
+ */
+static void MyFastIDCTRow(const double* in, double* out, const MyFastDCTPlan& plan, MyComplex* V, MyComplex* v) {
+    unsigned n = plan.n;
+    V[0] = plan.inv_pre[0] * in[0];
+    for (unsigned u = 1; u < n; u++) {
+	V[u] = plan.inv_pre[u] * MyComplex(in[u], in[n - u]);
+    }
+    if (n == 1)
+	v[0] = V[0];
+    else
+	MyFFTWork(v, V, 1, &plan.factors.front(), plan);
+    for (unsigned x = 0; x < n; x++) {
+	if (x % 2 == 0)
+	    out[x] = v[x / 2].real();
+	else
+	    out[x] = v[n - 1 - x / 2].real();
+    }
+}
+
+/**
+ * Implements a mono-dimensional DCT2 transform in O(n*log(n)) by means of a mixed-radix FFT. Inputs whose width can't be
+ * factored in radices 2, 3, 5 and 7 are handed to the table-driven MyMDCT2().
+ * @param in The input samples, in_stride elements apart.
+ * @param in_stride The distance between two consecutive input samples.
+ * @param out The output coefficients, out_stride elements apart (may alias the input).
+ * @param out_stride The distance between two consecutive output coefficients.
+ * @param n The input's width.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyFastMDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n, MyDCTWorkspace* ws) {
+    if (!MyFastDCTSupports(n)) return MyMDCT2(in, in_stride, out, out_stride, n, ws);
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyFastDCTPlan& plan = MyFastDCTWorkspacePlan(ws->row_plan, n);
+    double* x = MyDCTWorkspaceBuffer(ws->step, n);
+    for (unsigned i = 0; i < n; i++) x[i] = in[i * in_stride];
+    MyFastDCTRow(x, x, plan, MyDCTWorkspaceBuffer(ws->fft_in, n), MyDCTWorkspaceBuffer(ws->fft_out, n));
+    for (unsigned u = 0; u < n; u++) out[u * out_stride] = x[u];
+}
+
+/**
+ * Vector-based front end for MyFastMDCT2().
+ * @param in The input vector.
+ * @return A vector containing the DCT of the input.
+ */
+std::vector<double> MyFastMDCT2(const std::vector<double>& in) {
+    std::vector<double> out(in.size());
+    if (out.empty()) return out;
+    MyFastMDCT2(&in.front(), 1, &out.front(), 1, in.size());
+    return out;
+}
+
+/**
+ * Runs the column pass of the fast 2-D transforms: the contiguous matrix is transposed (in place if it's square, into the
+ * second workspace buffer otherwise), each of its rows is transformed and the result is transposed back into the output.
+ * @param step The contiguous rows*cols matrix produced by the row pass.
+ * @param out The output matrix, whose rows are out_stride elements apart.
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param plan The plan for a rows-wide transform.
+ * @param ws The workspace.
+ * @param row_fn The row transform (MyFastDCTRow() or MyFastIDCTRow()).
+ */
+static void MyFastColPass(double* step, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+			  const MyFastDCTPlan& plan, MyDCTWorkspace* ws,
+			  void (*row_fn)(const double*, double*, const MyFastDCTPlan&, MyComplex*, MyComplex*)) {
+    MyComplex* a = &ws->fft_in.front();
+    MyComplex* b = &ws->fft_out.front();
+    double* cols_buf = step;
+    if (rows == cols) {
+	MyDCTTransposeInPlace(step, rows);
+    } else {
+	cols_buf = MyDCTWorkspaceBuffer(ws->step2, static_cast<size_t>(rows) * cols);
+	MyDCTTransposeStrided(step, cols, cols_buf, rows, rows, cols);
+    }
+    for (unsigned c = 0; c < cols; c++) {
+	double* col = &cols_buf[static_cast<size_t>(c) * rows];
+	row_fn(col, col, plan, a, b);
+    }
+    MyDCTTransposeStrided(cols_buf, rows, out, out_stride, cols, rows);
+}
+
+/**
+ * Separable multi-dimensional DCT2 built on the fast mono-dimensional transform, taking O(rows*cols*log(rows*cols)). No
+ * memory is allocated when a workspace that has already been used for a matrix of the same size is provided. Inputs whose
+ * sides can't be factored in radices 2, 3, 5 and 7 are handed to the table-driven MyDDCT2().
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyFastDDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		 MyDCTWorkspace* ws) {
+    if (!MyFastDCTSupports(rows) || !MyFastDCTSupports(cols)) return MyDDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyFastDCTPlan& row_plan = MyFastDCTWorkspacePlan(ws->row_plan, cols);
+    const MyFastDCTPlan& col_plan = MyFastDCTWorkspacePlan(ws->col_plan, rows);
+    MyComplex* a = MyDCTWorkspaceBuffer(ws->fft_in, std::max(rows, cols));
+    MyComplex* b = MyDCTWorkspaceBuffer(ws->fft_out, std::max(rows, cols));
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    for (unsigned r = 0; r < rows; r++) MyFastDCTRow(&in[r * in_stride], &step[static_cast<size_t>(r) * cols], row_plan, a, b);
+    MyFastColPass(step, out, out_stride, rows, cols, col_plan, ws, MyFastDCTRow);
+}
+
+/**
+ * Vector-based front end for MyFastDDCT2().
+ * @param in The input vector (a rows*cols matrix).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyFastDDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyFastDDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for MyFastDDCT2(), for square matrices.
+ * @param in The input vector (a n*n matrix).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the DCT of the input (a n*n matrix).
+ */
+std::vector<double> MyFastDDCT2(const std::vector<double>& in, unsigned n) { return MyFastDDCT2(in, n, n); }
+
+/**
+ * Implements a mono-dimensional DCT3 transform (the inverse of MyFastMDCT2()) in O(n*log(n)). Inputs whose width can't be
+ * factored in radices 2, 3, 5 and 7 are handed to the table-driven MyMIDCT2().
+ * @param in The input coefficients, in_stride elements apart.
+ * @param in_stride The distance between two consecutive input coefficients.
+ * @param out The output samples, out_stride elements apart (may alias the input).
+ * @param out_stride The distance between two consecutive output samples.
+ * @param n The input's width.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyFastMIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n, MyDCTWorkspace* ws) {
+    if (!MyFastDCTSupports(n)) return MyMIDCT2(in, in_stride, out, out_stride, n, ws);
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyFastDCTPlan& plan = MyFastDCTWorkspacePlan(ws->row_plan, n);
+    double* x = MyDCTWorkspaceBuffer(ws->step, n);
+    for (unsigned u = 0; u < n; u++) x[u] = in[u * in_stride];
+    MyFastIDCTRow(x, x, plan, MyDCTWorkspaceBuffer(ws->fft_in, n), MyDCTWorkspaceBuffer(ws->fft_out, n));
+    for (unsigned i = 0; i < n; i++) out[i * out_stride] = x[i];
+}
+
+/**
+ * Vector-based front end for MyFastMIDCT2().
+ * @param in The input vector (the DCT coefficients).
+ * @return A vector containing the inverse DCT of the input.
+ */
+std::vector<double> MyFastMIDCT2(const std::vector<double>& in) {
+    std::vector<double> out(in.size());
+    if (out.empty()) return out;
+    MyFastMIDCT2(&in.front(), 1, &out.front(), 1, in.size());
+    return out;
+}
+
+/**
+ * Separable multi-dimensional DCT3 (the inverse of MyFastDDCT2()) built on the fast mono-dimensional transform. Same
+ * considerations about the workspace apply. Inputs whose sides can't be factored in radices 2, 3, 5 and 7 are handed to the
+ * table-driven MyDIDCT2().
+ * @param in The input matrix of DCT coefficients, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MyFastDIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		  MyDCTWorkspace* ws) {
+    if (!MyFastDCTSupports(rows) || !MyFastDCTSupports(cols)) return MyDIDCT2(in, in_stride, out, out_stride, rows, cols, ws);
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyFastDCTPlan& row_plan = MyFastDCTWorkspacePlan(ws->row_plan, cols);
+    const MyFastDCTPlan& col_plan = MyFastDCTWorkspacePlan(ws->col_plan, rows);
+    MyComplex* a = MyDCTWorkspaceBuffer(ws->fft_in, std::max(rows, cols));
+    MyComplex* b = MyDCTWorkspaceBuffer(ws->fft_out, std::max(rows, cols));
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    for (unsigned r = 0; r < rows; r++) MyFastIDCTRow(&in[r * in_stride], &step[static_cast<size_t>(r) * cols], row_plan, a, b);
+    MyFastColPass(step, out, out_stride, rows, cols, col_plan, ws, MyFastIDCTRow);
+}
+
+/**
+ * Vector-based front end for MyFastDIDCT2().
+ * @param in The input vector (the rows*cols matrix of DCT coefficients).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the inverse DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MyFastDIDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MyFastDIDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for MyFastDIDCT2(), for square matrices.
+ * @param in The input vector (the n*n matrix of DCT coefficients).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the inverse DCT of the input (a n*n matrix).
+ */
+std::vector<double> MyFastDIDCT2(const std::vector<double>& in, unsigned n) { return MyFastDIDCT2(in, n, n); }
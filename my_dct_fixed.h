@@ -0,0 +1,265 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_MY_DCT_FIXED_H
+#define PROJ2_MY_DCT_FIXED_H
+
+/*
+ * Compile-time specialized DCT kernels for the block sizes used by the compressor (4x4, 8x8 and 16x16). With such small blocks
+ * the cost of the generic transforms is dominated by what happens around the arithmetic (allocations, plan lookups, dispatch),
+ * so these kernels work on caller-provided strided buffers, keep their tables in function-local statics and let the compiler
+ * fully unroll every loop. The 8-point transform is computed with Loeffler's factorization instead of a matrix product: an
+ * even/odd butterfly, a rotation for the even part and two rotations plus a sqrt(2) scale for the odd part.
+ */
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "my_dct.h"
+
+#define MYDCT_FIXED_UNROLL _Pragma("GCC unroll 16")
+
+/**
+ * The scaled cosine matrix of a N-wide DCT-II, same layout as MyDCTBasis.
+ */
+template <unsigned N>
+struct MyFixedDCTTable {
+    double table[N * N];
+    MyFixedDCTTable() {
+	for (unsigned u = 0; u < N; u++) {
+	    double coeff = u == 0 ? sqrt(1 / (double)N) : sqrt(2 / (double)N);
+	    for (unsigned x = 0; x < N; x++) {
+		table[u * N + x] = coeff * cos((M_PI * (2 * x + 1) * u) / (2 * N));
+	    }
+	}
+    }
+};
+
+template <unsigned N>
+struct MyFixedDCT {
+    static const double* basis() {
+	static const MyFixedDCTTable<N> basis;  // Thread-safe initialization since C++11
+	return basis.table;
+    }
+
+    /**
+     * Computes the DCT-II of N samples.
+     * @param in The input samples, in_stride elements apart.
+     * @param out The output coefficients, out_stride elements apart (must not alias the input).
+     */
+    static inline void forward(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+	const double* t = basis();
+	double x[N];
+	MYDCT_FIXED_UNROLL
+	for (unsigned i = 0; i < N; i++) x[i] = in[i * in_stride];
+	MYDCT_FIXED_UNROLL
+	for (unsigned u = 0; u < N; u++) {
+	    double sum = .0f;
+	    MYDCT_FIXED_UNROLL
+	    for (unsigned i = 0; i < N; i++) sum += t[u * N + i] * x[i];
+	    out[u * out_stride] = sum;
+	}
+    }
+
+    /**
+     * Computes the DCT-III (inverse DCT-II) of N coefficients.
+     * @param in The input coefficients, in_stride elements apart.
+     * @param out The output samples, out_stride elements apart (must not alias the input).
+     */
+    static inline void inverse(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+	const double* t = basis();
+	double X[N];
+	MYDCT_FIXED_UNROLL
+	for (unsigned u = 0; u < N; u++) X[u] = in[u * in_stride];
+	MYDCT_FIXED_UNROLL
+	for (unsigned i = 0; i < N; i++) {
+	    double sum = .0f;
+	    MYDCT_FIXED_UNROLL
+	    for (unsigned u = 0; u < N; u++) sum += t[u * N + i] * X[u];
+	    out[i * out_stride] = sum;
+	}
+    }
+
+    /**
+     * Computes the 2-D DCT-II of a NxN block: a pass on the rows, then one on the columns, with no transposition.
+     * @param in The input block, whose rows are in_stride elements apart.
+     * @param out The output block, whose rows are out_stride elements apart (may alias the input).
+     */
+    static inline void forward2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+	double tmp[N * N];
+	MYDCT_FIXED_UNROLL
+	for (unsigned r = 0; r < N; r++) forward(in + r * in_stride, 1, tmp + r * N, 1);
+	MYDCT_FIXED_UNROLL
+	for (unsigned c = 0; c < N; c++) forward(tmp + c, N, out + c, out_stride);
+    }
+
+    /**
+     * Computes the 2-D DCT-III of a NxN block.
+     * @param in The input block, whose rows are in_stride elements apart.
+     * @param out The output block, whose rows are out_stride elements apart (may alias the input).
+     */
+    static inline void inverse2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+	double tmp[N * N];
+	MYDCT_FIXED_UNROLL
+	for (unsigned r = 0; r < N; r++) inverse(in + r * in_stride, 1, tmp + r * N, 1);
+	MYDCT_FIXED_UNROLL
+	for (unsigned c = 0; c < N; c++) inverse(tmp + c, N, out + c, out_stride);
+    }
+};
+
+// cos(k * pi / 16), as used by the 8-point butterflies
+#define MYDCT_C1 0.98078528040323044913
+#define MYDCT_C2 0.92387953251128675613
+#define MYDCT_C3 0.83146961230254523708
+#define MYDCT_C4 0.70710678118654752440
+#define MYDCT_C5 0.55557023301960222474
+#define MYDCT_C6 0.38268343236508977173
+#define MYDCT_C7 0.19509032201612826785
+#define MYDCT_SQRT2 1.41421356237309504880
+
+/**
+ * 8-point DCT-II after Loeffler, Ligtenberg and Moschytz: the sums s(k) = x(k) + x(7-k) feed a 4-point DCT that yields the
+ * even coefficients, the differences d(k) = x(k) - x(7-k) yield the odd ones through a rotation by 3pi/16 of (d3, d0), one
+ * by pi/16 of (d2, d1), a butterfly and a sqrt(2) scale. Every coefficient already carries its alpha(u) scaling (1/2, or
+ * 1/2 * cos(pi/4) for the DC), folded into the constants, so the result matches MyMDCT2(). The rotations take 4
+ * multiplications each rather than the 3 of the original paper, which trade a multiplication for an addition and a little
+ * precision: with the constant products written first, so that the compiler folds them, that's 6 multiplications for
+ * the even part and 10 for the odd one, 16 in all, against Loeffler's 11 (which leave the scaling to the caller) and 22
+ * before.
+ */
+template <>
+inline void MyFixedDCT<8>::forward(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+    double x0 = in[0], x1 = in[in_stride], x2 = in[2 * in_stride], x3 = in[3 * in_stride];
+    double x4 = in[4 * in_stride], x5 = in[5 * in_stride], x6 = in[6 * in_stride], x7 = in[7 * in_stride];
+    double s0 = x0 + x7, s1 = x1 + x6, s2 = x2 + x5, s3 = x3 + x4;
+    double d0 = x0 - x7, d1 = x1 - x6, d2 = x2 - x5, d3 = x3 - x4;
+    // Even part
+    double ss0 = s0 + s3, ss1 = s1 + s2, dd0 = s0 - s3, dd1 = s1 - s2;
+    out[0] = .5 * MYDCT_C4 * (ss0 + ss1);
+    out[4 * out_stride] = .5 * MYDCT_C4 * (ss0 - ss1);
+    out[2 * out_stride] = .5 * MYDCT_C2 * dd0 + .5 * MYDCT_C6 * dd1;
+    out[6 * out_stride] = .5 * MYDCT_C6 * dd0 - .5 * MYDCT_C2 * dd1;
+    // Odd part, scaled by 1/(2 * sqrt(2)) = cos(pi/4) / 2 so that the butterfly yields the coefficients
+    const double k = .5 * MYDCT_C4;
+    double r0 = k * MYDCT_C3 * d3 + k * MYDCT_C5 * d0, r3 = k * MYDCT_C3 * d0 - k * MYDCT_C5 * d3;
+    double r1 = k * MYDCT_C1 * d2 + k * MYDCT_C7 * d1, r2 = k * MYDCT_C1 * d1 - k * MYDCT_C7 * d2;
+    double e0 = r0 + r2, e2 = r0 - r2, e3 = r3 + r1, e1 = r3 - r1;
+    out[out_stride] = e3 + e0;
+    out[7 * out_stride] = e3 - e0;
+    out[3 * out_stride] = MYDCT_SQRT2 * e1;
+    out[5 * out_stride] = MYDCT_SQRT2 * e2;
+}
+
+/**
+ * 8-point DCT-III, obtained by running the butterflies of MyFixedDCT<8>::forward() backwards (the transform is orthonormal, so
+ * its inverse is its transpose).
+ */
+template <>
+inline void MyFixedDCT<8>::inverse(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride) {
+    double X0 = in[0], X1 = in[in_stride], X2 = in[2 * in_stride], X3 = in[3 * in_stride];
+    double X4 = in[4 * in_stride], X5 = in[5 * in_stride], X6 = in[6 * in_stride], X7 = in[7 * in_stride];
+    // Even part
+    double ss0 = .5 * MYDCT_C4 * (X0 + X4), ss1 = .5 * MYDCT_C4 * (X0 - X4);
+    double dd0 = .5 * MYDCT_C2 * X2 + .5 * MYDCT_C6 * X6, dd1 = .5 * MYDCT_C6 * X2 - .5 * MYDCT_C2 * X6;
+    double s0 = ss0 + dd0, s3 = ss0 - dd0, s1 = ss1 + dd1, s2 = ss1 - dd1;
+    // Odd part, the flow graph of the forward one transposed
+    const double k = .5 * MYDCT_C4;
+    double e3 = X1 + X7, e0 = X1 - X7, e1 = MYDCT_SQRT2 * X3, e2 = MYDCT_SQRT2 * X5;
+    double r0 = e0 + e2, r2 = e0 - e2, r3 = e3 + e1, r1 = e3 - e1;
+    double d3 = k * MYDCT_C3 * r0 - k * MYDCT_C5 * r3, d0 = k * MYDCT_C5 * r0 + k * MYDCT_C3 * r3;
+    double d2 = k * MYDCT_C1 * r1 - k * MYDCT_C7 * r2, d1 = k * MYDCT_C7 * r1 + k * MYDCT_C1 * r2;
+    out[0] = s0 + d0;
+    out[7 * out_stride] = s0 - d0;
+    out[out_stride] = s1 + d1;
+    out[6 * out_stride] = s1 - d1;
+    out[2 * out_stride] = s2 + d2;
+    out[5 * out_stride] = s2 - d2;
+    out[3 * out_stride] = s3 + d3;
+    out[4 * out_stride] = s3 - d3;
+}
+
+/**
+ * @param n The width of the (square) block.
+ * @return Whether a specialized kernel exists for blocks of this size.
+ */
+inline bool MyFixedDCTSupports(unsigned n) { return n == 4 || n == 8 || n == 16; }
+
+/**
+ * Runs the specialized 2-D DCT-II kernel for a nxn block.
+ * @param in The input block, whose rows are in_stride elements apart.
+ * @param out The output block, whose rows are out_stride elements apart (may alias the input).
+ * @param n The width of the block, must satisfy MyFixedDCTSupports().
+ */
+inline void MyFixedDDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n) {
+    switch (n) {
+	case 4:
+	    MyFixedDCT<4>::forward2(in, in_stride, out, out_stride);
+	    break;
+	case 8:
+	    MyFixedDCT<8>::forward2(in, in_stride, out, out_stride);
+	    break;
+	case 16:
+	    MyFixedDCT<16>::forward2(in, in_stride, out, out_stride);
+	    break;
+	default:
+	    throw std::invalid_argument("No specialized kernel exists for the given block size.");
+    }
+}
+
+/**
+ * Runs the specialized 2-D DCT-III kernel for a nxn block.
+ * @param in The input block, whose rows are in_stride elements apart.
+ * @param out The output block, whose rows are out_stride elements apart (may alias the input).
+ * @param n The width of the block, must satisfy MyFixedDCTSupports().
+ */
+inline void MyFixedDIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned n) {
+    switch (n) {
+	case 4:
+	    MyFixedDCT<4>::inverse2(in, in_stride, out, out_stride);
+	    break;
+	case 8:
+	    MyFixedDCT<8>::inverse2(in, in_stride, out, out_stride);
+	    break;
+	case 16:
+	    MyFixedDCT<16>::inverse2(in, in_stride, out, out_stride);
+	    break;
+	default:
+	    throw std::invalid_argument("No specialized kernel exists for the given block size.");
+    }
+}
+
+/**
+ * Vector-based front end for the specialized kernels, falling back to MyFastDDCT2() for unsupported sizes.
+ * @param in The input vector (a n*n matrix).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the DCT of the input (a n*n matrix).
+ */
+inline std::vector<double> MyFixedDDCT2(const std::vector<double>& in, unsigned n) {
+    if (!MyFixedDCTSupports(n)) return MyFastDDCT2(in, n);
+    std::vector<double> out(n * n);
+    MyFixedDDCT2(&in.front(), n, &out.front(), n, n);
+    return out;
+}
+
+#endif  // PROJ2_MY_DCT_FIXED_H
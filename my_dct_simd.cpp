@@ -0,0 +1,436 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+/*
+ * SIMD separable passes.
+ *
+ * Written as matrix products, the 2-D transform of a n*n matrix X is Y = T * X * T', where T is the basis table: the row
+ * pass computes Z = X * T' and the column pass Y = T * Z (the inverse swaps T and T'). Both passes are then computed by the
+ * same kernel, C = A * B, which broadcasts one element of A and multiplies it by a whole row of B: every instruction works
+ * on several output columns (i.e. several rows' or columns' transforms) at once, the loads are contiguous and no
+ * transposition is ever needed. The kernel is compiled once per instruction set and the best one supported by the CPU
+ * (as reported by CPUID) is picked at runtime, so the same binary runs everywhere.
+ */
+
+#include "my_dct.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYDCT_SIMD_X86 1
+#else
+#define MYDCT_SIMD_X86 0
+#endif
+
+typedef void (*MySimdGemmFn)(const double*, ptrdiff_t, const double*, ptrdiff_t, double*, ptrdiff_t, unsigned, unsigned,
+			     unsigned);
+
+/**
+ * Portable version of the kernel, used when no vector extension is available.
+ * @param a The left-hand m*k matrix, whose rows are lda elements apart.
+ * @param b The right-hand k*n matrix, whose rows are ldb elements apart.
+ * @param c The m*n output matrix, whose rows are ldc elements apart (must not alias the inputs).
+ */
+static void MySimdGemmScalar(const double* a, ptrdiff_t lda, const double* b, ptrdiff_t ldb, double* c, ptrdiff_t ldc,
+			     unsigned m, unsigned k, unsigned n) {
+    for (unsigned i = 0; i < m; i++) {
+	double* c_row = c + i * ldc;
+	for (unsigned j = 0; j < n; j++) c_row[j] = .0f;
+	for (unsigned l = 0; l < k; l++) {
+	    double a_il = a[i * lda + l];
+	    const double* b_row = b + l * ldb;
+	    for (unsigned j = 0; j < n; j++) c_row[j] += a_il * b_row[j];
+	}
+    }
+}
+
+#if MYDCT_SIMD_X86
+/*
+ * Every vector kernel walks the output row in strips of four registers (to hide the latency of the multiply-adds), then in
+ * single registers, then finishes the tail with scalar code.
+ */
+
+__attribute__((target("sse2"))) static void MySimdGemmSSE2(const double* a, ptrdiff_t lda, const double* b,
+	ptrdiff_t ldb, double* c, ptrdiff_t ldc, unsigned m, unsigned k, unsigned n) {
+    for (unsigned i = 0; i < m; i++) {
+	const double* a_row = a + i * lda;
+	double* c_row = c + i * ldc;
+	unsigned j = 0;
+	for (; j + 8 <= n; j += 8) {
+	    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd(), acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		__m128d a_il = _mm_set1_pd(a_row[l]);
+		const double* b_row = b + l * ldb + j;
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(a_il, _mm_loadu_pd(b_row)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(a_il, _mm_loadu_pd(b_row + 2)));
+		acc2 = _mm_add_pd(acc2, _mm_mul_pd(a_il, _mm_loadu_pd(b_row + 4)));
+		acc3 = _mm_add_pd(acc3, _mm_mul_pd(a_il, _mm_loadu_pd(b_row + 6)));
+	    }
+	    _mm_storeu_pd(c_row + j, acc0);
+	    _mm_storeu_pd(c_row + j + 2, acc1);
+	    _mm_storeu_pd(c_row + j + 4, acc2);
+	    _mm_storeu_pd(c_row + j + 6, acc3);
+	}
+	for (; j + 2 <= n; j += 2) {
+	    __m128d acc = _mm_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(a_row[l]), _mm_loadu_pd(b + l * ldb + j)));
+	    }
+	    _mm_storeu_pd(c_row + j, acc);
+	}
+	for (; j < n; j++) {
+	    double acc = .0f;
+	    for (unsigned l = 0; l < k; l++) acc += a_row[l] * b[l * ldb + j];
+	    c_row[j] = acc;
+	}
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void MySimdGemmAVX2(const double* a, ptrdiff_t lda, const double* b,
+	ptrdiff_t ldb, double* c, ptrdiff_t ldc, unsigned m, unsigned k, unsigned n) {
+    for (unsigned i = 0; i < m; i++) {
+	const double* a_row = a + i * lda;
+	double* c_row = c + i * ldc;
+	unsigned j = 0;
+	for (; j + 16 <= n; j += 16) {
+	    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd(), acc2 = _mm256_setzero_pd(),
+		    acc3 = _mm256_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		__m256d a_il = _mm256_set1_pd(a_row[l]);
+		const double* b_row = b + l * ldb + j;
+		acc0 = _mm256_fmadd_pd(a_il, _mm256_loadu_pd(b_row), acc0);
+		acc1 = _mm256_fmadd_pd(a_il, _mm256_loadu_pd(b_row + 4), acc1);
+		acc2 = _mm256_fmadd_pd(a_il, _mm256_loadu_pd(b_row + 8), acc2);
+		acc3 = _mm256_fmadd_pd(a_il, _mm256_loadu_pd(b_row + 12), acc3);
+	    }
+	    _mm256_storeu_pd(c_row + j, acc0);
+	    _mm256_storeu_pd(c_row + j + 4, acc1);
+	    _mm256_storeu_pd(c_row + j + 8, acc2);
+	    _mm256_storeu_pd(c_row + j + 12, acc3);
+	}
+	for (; j + 4 <= n; j += 4) {
+	    __m256d acc = _mm256_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		acc = _mm256_fmadd_pd(_mm256_set1_pd(a_row[l]), _mm256_loadu_pd(b + l * ldb + j), acc);
+	    }
+	    _mm256_storeu_pd(c_row + j, acc);
+	}
+	for (; j < n; j++) {
+	    double acc = .0f;
+	    for (unsigned l = 0; l < k; l++) acc += a_row[l] * b[l * ldb + j];
+	    c_row[j] = acc;
+	}
+    }
+}
+
+__attribute__((target("avx512f"))) static void MySimdGemmAVX512(const double* a, ptrdiff_t lda, const double* b,
+	ptrdiff_t ldb, double* c, ptrdiff_t ldc, unsigned m, unsigned k, unsigned n) {
+    for (unsigned i = 0; i < m; i++) {
+	const double* a_row = a + i * lda;
+	double* c_row = c + i * ldc;
+	unsigned j = 0;
+	for (; j + 32 <= n; j += 32) {
+	    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd(), acc2 = _mm512_setzero_pd(),
+		    acc3 = _mm512_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		__m512d a_il = _mm512_set1_pd(a_row[l]);
+		const double* b_row = b + l * ldb + j;
+		acc0 = _mm512_fmadd_pd(a_il, _mm512_loadu_pd(b_row), acc0);
+		acc1 = _mm512_fmadd_pd(a_il, _mm512_loadu_pd(b_row + 8), acc1);
+		acc2 = _mm512_fmadd_pd(a_il, _mm512_loadu_pd(b_row + 16), acc2);
+		acc3 = _mm512_fmadd_pd(a_il, _mm512_loadu_pd(b_row + 24), acc3);
+	    }
+	    _mm512_storeu_pd(c_row + j, acc0);
+	    _mm512_storeu_pd(c_row + j + 8, acc1);
+	    _mm512_storeu_pd(c_row + j + 16, acc2);
+	    _mm512_storeu_pd(c_row + j + 24, acc3);
+	}
+	for (; j < n; j += 8) {  // The tail is handled with a masked register
+	    __mmask8 mask = n - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - j)) - 1);
+	    __m512d acc = _mm512_setzero_pd();
+	    for (unsigned l = 0; l < k; l++) {
+		acc = _mm512_fmadd_pd(_mm512_set1_pd(a_row[l]),
+				      _mm512_maskz_loadu_pd(mask, b + l * ldb + j), acc);
+	    }
+	    _mm512_mask_storeu_pd(c_row + j, mask, acc);
+	}
+    }
+}
+#endif
+
+// Written by MyDCTSimdForceIsa() while transforms may be running on other threads; every kernel entry loads it once, through
+// MySimdGetGemm(), so a single transform never mixes two instruction sets
+static std::atomic<int> simd_forced_isa(-1);
+
+/**
+ * Queries CPUID (through the compiler's builtins, which also check that the OS saves the extended registers) for the best
+ * instruction set the kernels can use. The result is computed once.
+ * @return One of the MYDCT_ISA_* constants.
+ */
+int MyDCTSimdDetectIsa() {
+    static const int isa = [] {
+#if MYDCT_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return MYDCT_ISA_AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return MYDCT_ISA_AVX2;
+	if (__builtin_cpu_supports("sse2")) return MYDCT_ISA_SSE2;
+#endif
+	return MYDCT_ISA_SCALAR;
+    }();
+    return isa;
+}
+
+/**
+ * Restricts the kernels to a given instruction set (e.g. to compare them). Requests for an instruction set the CPU doesn't
+ * support are clamped to the detected one; a negative value restores the automatic selection.
+ * @param isa One of the MYDCT_ISA_* constants, or -1.
+ */
+void MyDCTSimdForceIsa(int isa) { simd_forced_isa.store(isa, std::memory_order_relaxed); }
+
+/**
+ * @return The instruction set that the next call to MySimdDDCT2() or MySimdDIDCT2() will use.
+ */
+int MyDCTSimdActiveIsa() {
+    int detected = MyDCTSimdDetectIsa();
+    int forced = simd_forced_isa.load(std::memory_order_relaxed);
+    if (forced < 0 || forced > detected) return detected;
+    return forced;
+}
+
+/**
+ * @param isa One of the MYDCT_ISA_* constants.
+ * @return A human-readable name for the instruction set.
+ */
+const char* MyDCTSimdIsaName(int isa) {
+    switch (isa) {
+	case MYDCT_ISA_SSE2:
+	    return "SSE2";
+	case MYDCT_ISA_AVX2:
+	    return "AVX2";
+	case MYDCT_ISA_AVX512:
+	    return "AVX-512";
+	default:
+	    return "Scalar";
+    }
+}
+
+/**
+ * @return The kernel for the active instruction set. Callers fetch it once and use it for both passes.
+ */
+static MySimdGemmFn MySimdGetGemm() {
+    switch (MyDCTSimdActiveIsa()) {
+#if MYDCT_SIMD_X86
+	case MYDCT_ISA_SSE2:
+	    return MySimdGemmSSE2;
+	case MYDCT_ISA_AVX2:
+	    return MySimdGemmAVX2;
+	case MYDCT_ISA_AVX512:
+	    return MySimdGemmAVX512;
+#endif
+	default:
+	    return MySimdGemmScalar;
+    }
+}
+
+/**
+ * Vectorized separable multi-dimensional DCT2: a row pass (X * T') and a column pass (T * Z), both computed by the best
+ * vector kernel available. No memory is allocated when a workspace that has already been used for a matrix of the same size
+ * is provided. Same tolerance as MyDDCT2() applies.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MySimdDDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		 MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    MySimdGemmFn gemm = MySimdGetGemm();
+    gemm(in, in_stride, &row_basis.transposed.front(), cols, step, cols, rows, cols, cols);
+    gemm(&col_basis.table.front(), rows, step, cols, out, out_stride, rows, rows, cols);
+}
+
+/**
+ * Vector-based front end for MySimdDDCT2().
+ * @param in The input vector (a rows*cols matrix).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MySimdDDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MySimdDDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for MySimdDDCT2(), for square matrices.
+ * @param in The input vector (a n*n matrix).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the DCT of the input (a n*n matrix).
+ */
+std::vector<double> MySimdDDCT2(const std::vector<double>& in, unsigned n) { return MySimdDDCT2(in, n, n); }
+
+/**
+ * Vectorized separable multi-dimensional DCT3, the inverse of MySimdDDCT2(): a row pass (Y * T) and a column pass (T' * Z).
+ * Same considerations about the workspace apply.
+ * @param in The input matrix of DCT coefficients, whose rows are in_stride elements apart.
+ * @param in_stride The distance between the first elements of two consecutive input rows.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input if the strides match).
+ * @param out_stride The distance between the first elements of two consecutive output rows.
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ */
+void MySimdDIDCT2(const double* in, ptrdiff_t in_stride, double* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+		  MyDCTWorkspace* ws) {
+    if (rows == 0 || cols == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& row_basis = MyDCTWorkspaceBasis(ws->row_basis, cols);
+    const MyDCTBasis& col_basis = MyDCTWorkspaceBasis(ws->col_basis, rows);
+    double* step = MyDCTWorkspaceBuffer(ws->step, static_cast<size_t>(rows) * cols);
+    MySimdGemmFn gemm = MySimdGetGemm();
+    gemm(in, in_stride, &row_basis.table.front(), cols, step, cols, rows, cols, cols);
+    gemm(&col_basis.transposed.front(), rows, step, cols, out, out_stride, rows, rows, cols);
+}
+
+/**
+ * Vector-based front end for MySimdDIDCT2().
+ * @param in The input vector (the rows*cols matrix of DCT coefficients).
+ * @param rows The height of the matrix.
+ * @param cols The width of the matrix.
+ * @return A vector containing the inverse DCT of the input (a rows*cols matrix).
+ */
+std::vector<double> MySimdDIDCT2(const std::vector<double>& in, unsigned rows, unsigned cols) {
+    std::vector<double> out(static_cast<size_t>(rows) * cols);
+    if (out.empty()) return out;
+    MySimdDIDCT2(&in.front(), cols, &out.front(), cols, rows, cols);
+    return out;
+}
+
+/**
+ * Vector-based front end for MySimdDIDCT2(), for square matrices.
+ * @param in The input vector (the n*n matrix of DCT coefficients).
+ * @param n The height of the matrix (and its width, since it's square).
+ * @return A vector containing the inverse DCT of the input (a n*n matrix).
+ */
+std::vector<double> MySimdDIDCT2(const std::vector<double>& in, unsigned n) { return MySimdDIDCT2(in, n, n); }
+
+/*
+ * Batched transforms of many same-size blocks.
+ *
+ * Transforming a small block on its own leaves the kernel rows that are only n elements long, and pays the dispatch and the
+ * table lookups every time. Here, the same element of up to MYDCT_BATCH_LANES blocks is processed at once: stored in
+ * "lanes" (element e of block l at e * es + l), each line of the blocks becomes a matrix with one column per block, so both
+ * passes are T * X products whose rows are as long as the number of blocks, whatever n is. Blocks stored whole, one after
+ * the other (MYDCT_LAYOUT_INTERLEAVED), are gathered into lanes and scattered back a group at a time; blocks already stored
+ * in lanes (MYDCT_LAYOUT_SOA, element e of block k at e * blocks + k) are transformed where they are.
+ */
+
+/**
+ * Transforms up to MYDCT_BATCH_LANES blocks stored in lanes: the row pass into step, then the column pass into out.
+ * @param in The input blocks, whose element e of lane l is in[e * in_es + l].
+ * @param in_es The distance between two consecutive elements of a lane in the input.
+ * @param out The output blocks, laid out like the input (may be the input, since the row pass has read all of it when the
+ * column pass starts writing, but must not alias step).
+ * @param out_es The distance between two consecutive elements of a lane in the output.
+ * @param n The width of the blocks.
+ * @param lanes The number of blocks.
+ * @param coeffs The table for the forward transform, its transpose for the inverse one.
+ * @param step Room for n*n*lanes elements.
+ */
+static void MySimdBatchLanes(MySimdGemmFn gemm, const double* in, ptrdiff_t in_es, double* out, ptrdiff_t out_es,
+			     unsigned n, unsigned lanes, const double* coeffs, double* step) {
+    for (unsigned y = 0; y < n; y++)  // Row y: step[y][u] = sum over x of coeffs[u][x] * in[y][x]
+	gemm(coeffs, n, in + y * n * in_es, in_es, step + y * n * lanes, lanes, n, n, lanes);
+    for (unsigned x = 0; x < n; x++)  // Column x: out[v][x] = sum over y of coeffs[v][y] * step[y][x]
+	gemm(coeffs, n, step + x * lanes, static_cast<ptrdiff_t>(n) * lanes, out + x * out_es, n * out_es, n, n, lanes);
+}
+
+/**
+ * Common part of MyBatchDDCT2() and MyBatchDIDCT2().
+ */
+static void MySimdBatchTransform(const double* in, double* out, unsigned n, size_t blocks, int layout, MyDCTWorkspace* ws,
+				 bool inverse) {
+    if (layout != MYDCT_LAYOUT_INTERLEAVED && layout != MYDCT_LAYOUT_SOA) throw std::invalid_argument("Unknown layout.");
+    if (n == 0 || blocks == 0) return;
+    MyDCTWorkspace local;
+    if (ws == nullptr) ws = &local;
+    const MyDCTBasis& basis = MyDCTWorkspaceBasis(ws->row_basis, n);
+    const double* coeffs = inverse ? &basis.transposed.front() : &basis.table.front();
+    size_t area = static_cast<size_t>(n) * n;
+    double* step = MyDCTWorkspaceBuffer(ws->step, area * MYDCT_BATCH_LANES);
+    double* lanes_buf = MyDCTWorkspaceBuffer(ws->step2, area * MYDCT_BATCH_LANES);
+    MySimdGemmFn gemm = MySimdGetGemm();
+    for (size_t first = 0; first < blocks; first += MYDCT_BATCH_LANES) {
+	unsigned lanes = static_cast<unsigned>(std::min<size_t>(MYDCT_BATCH_LANES, blocks - first));
+	if (layout == MYDCT_LAYOUT_SOA) {  // A group only touches its own lanes, and reads them all before writing any
+	    ptrdiff_t es = static_cast<ptrdiff_t>(blocks);
+	    MySimdBatchLanes(gemm, in + first, es, out + first, es, n, lanes, coeffs, step);
+	    continue;
+	}
+	const double* src = in + first * area;
+	for (unsigned l = 0; l < lanes; l++) {  // Gather
+	    for (size_t e = 0; e < area; e++) lanes_buf[e * lanes + l] = src[l * area + e];
+	}
+	MySimdBatchLanes(gemm, lanes_buf, lanes, lanes_buf, lanes, n, lanes, coeffs, step);  // Only the row pass reads it
+	double* dst = out + first * area;
+	for (unsigned l = 0; l < lanes; l++) {  // Scatter
+	    for (size_t e = 0; e < area; e++) dst[l * area + e] = lanes_buf[e * lanes + l];
+	}
+    }
+}
+
+/**
+ * Vectorized DCT2 of many n*n blocks at once (see above), for loops that would otherwise transform them one by one. Same
+ * tolerance as MyDDCT2() applies.
+ * @param in The blocks, in the given layout.
+ * @param out The transformed blocks, in the same layout (may be the same as the input).
+ * @param n The width (and height) of each block.
+ * @param blocks The number of blocks.
+ * @param layout MYDCT_LAYOUT_INTERLEAVED or MYDCT_LAYOUT_SOA.
+ * @param ws A workspace to reuse across calls, or nullptr to use a temporary one.
+ * @throws std::invalid_argument If the layout is unknown.
+ */
+void MyBatchDDCT2(const double* in, double* out, unsigned n, size_t blocks, int layout, MyDCTWorkspace* ws) {
+    MySimdBatchTransform(in, out, n, blocks, layout, ws, false);
+}
+
+/**
+ * Inverse of MyBatchDDCT2(), with the same parameters.
+ */
+void MyBatchDIDCT2(const double* in, double* out, unsigned n, size_t blocks, int layout, MyDCTWorkspace* ws) {
+    MySimdBatchTransform(in, out, n, blocks, layout, ws, true);
+}
@@ -0,0 +1,252 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_MY_DCT_TYPED_H
+#define PROJ2_MY_DCT_TYPED_H
+
+/*
+ * Table-driven 2-D transforms templated on the sample type. The input of the compressor is made of 8-bit pixels, so carrying
+ * every sample as a double halves the SIMD width and doubles the memory traffic for no visible gain: these transforms can
+ * also work on floats and on 32 or 16-bit fixed-point integers. Fixed-point samples carry frac_bits fractional bits (chosen by
+ * the caller, see MyTypedDCTFracBits()), the basis is stored with MyDCTSample<T>::coeff_bits of them and the products are
+ * summed in a wider accumulator, then rounded back to the sample type (saturating) after each pass.
+ *
+ * The passes are written as a sequence of scaled vector additions (one per input sample) instead of dot products, so the
+ * compiler can vectorize them without reordering any floating-point sum.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "my_dct.h"
+
+#define MYDCT_RESTRICT __restrict  // The passes never write through their input pointers
+
+#define MYDCT_PRECISION_DOUBLE 0
+#define MYDCT_PRECISION_FLOAT 1
+#define MYDCT_PRECISION_FIXED32 2
+#define MYDCT_PRECISION_FIXED16 3
+
+inline const char* MyDCTPrecisionName(int precision) {
+    static const char* names[] = {"double", "float", "32-bit fixed", "16-bit fixed"};
+    return precision >= MYDCT_PRECISION_DOUBLE && precision <= MYDCT_PRECISION_FIXED16 ? names[precision] : "?";
+}
+
+/**
+ * How a sample type is stored and computed with: Coeff is the type of the basis table, Acc the one of the sums.
+ */
+template <typename T>
+struct MyDCTSample;
+
+template <>
+struct MyDCTSample<double> {
+    typedef double Coeff;
+    typedef double Acc;
+    static const bool fixed = false;
+    static Coeff coeff(double c) { return c; }
+    static double narrow(Acc a) { return a; }
+    static double fromInt(int v, int) { return v; }
+    static double fromDouble(double v, int) { return v; }
+    static double toDouble(double v, int) { return v; }
+};
+
+template <>
+struct MyDCTSample<float> {
+    typedef float Coeff;
+    typedef float Acc;
+    static const bool fixed = false;
+    static Coeff coeff(double c) { return static_cast<float>(c); }
+    static float narrow(Acc a) { return a; }
+    static float fromInt(int v, int) { return static_cast<float>(v); }
+    static float fromDouble(double v, int) { return static_cast<float>(v); }
+    static double toDouble(float v, int) { return v; }
+};
+
+/**
+ * Common part of the fixed-point sample types.
+ */
+template <typename T, typename C, typename A, int CoeffBits>
+struct MyDCTFixedSample {
+    typedef C Coeff;
+    typedef A Acc;
+    static const bool fixed = true;
+    static const int coeff_bits = CoeffBits;
+    static Coeff coeff(double c) { return static_cast<Coeff>(std::lround(std::ldexp(c, CoeffBits))); }
+    static T saturate(A a) {
+	return static_cast<T>(std::min<A>(std::max<A>(a, std::numeric_limits<T>::min()), std::numeric_limits<T>::max()));
+    }
+    static T narrow(A a) { return saturate((a + (A(1) << (CoeffBits - 1))) >> CoeffBits); }
+    static T fromInt(int v, int frac_bits) {  // v must fit, once scaled
+	return static_cast<T>(frac_bits >= 0 ? static_cast<A>(v) * (A(1) << frac_bits) : static_cast<A>(v) >> -frac_bits);
+    }
+    static T fromDouble(double v, int frac_bits) { return saturate(static_cast<A>(std::llround(std::ldexp(v, frac_bits)))); }
+    static double toDouble(T v, int frac_bits) { return std::ldexp(static_cast<double>(v), -frac_bits); }
+};
+
+// The basis never exceeds 1 in magnitude, hence one integer bit (plus the sign) is enough
+template <>
+struct MyDCTSample<int32_t> : MyDCTFixedSample<int32_t, int32_t, int64_t, 30> {};
+template <>
+struct MyDCTSample<int16_t> : MyDCTFixedSample<int16_t, int16_t, int32_t, 14> {};
+
+/**
+ * The number of fractional bits fixed-point samples can have without overflowing while transforming data whose values
+ * don't exceed max_abs: each output of an orthonormal transform is at most max_abs * sqrt(rows * cols), so that is what has
+ * to fit. Can be negative for large values (the samples are then scaled down). Meaningless for floating-point types.
+ * @param max_abs The largest magnitude in the input.
+ * @param rows The number of rows of the transform.
+ * @param cols The number of columns of the transform.
+ */
+template <typename T>
+inline int MyTypedDCTFracBits(double max_abs, unsigned rows, unsigned cols) {
+    if (!MyDCTSample<T>::fixed) return 0;
+    double bound = std::max(max_abs, 1.0) * std::sqrt(static_cast<double>(rows) * cols);
+    double limit = static_cast<double>(std::numeric_limits<T>::max());
+    return static_cast<int>(std::floor(std::log2(limit / bound)));
+}
+
+/**
+ * Tables and scratch memory for the typed transforms; like MyDCTWorkspace, it's only set up again when the size changes and
+ * must not be shared between threads.
+ */
+template <typename T>
+struct MyTypedDCTWorkspace {
+    typedef typename MyDCTSample<T>::Coeff Coeff;
+    typedef typename MyDCTSample<T>::Acc Acc;
+    unsigned rows = 0, cols = 0;
+    std::vector<Coeff> row_basis;             // rows x rows, [u][x]
+    std::vector<Coeff> col_basis, col_basis_t;  // cols x cols, [u][x] and [x][u]
+    std::vector<T> step;
+    std::vector<Acc> acc;
+
+    void prepare(unsigned m_rows, unsigned m_cols) {
+	if (m_rows == rows && m_cols == cols) return;
+	std::shared_ptr<const MyDCTBasis> r = MyDCTGetBasis(m_rows), c = MyDCTGetBasis(m_cols);
+	row_basis.resize(static_cast<size_t>(m_rows) * m_rows);
+	for (size_t i = 0; i < row_basis.size(); i++) row_basis[i] = MyDCTSample<T>::coeff(r->table[i]);
+	col_basis.resize(static_cast<size_t>(m_cols) * m_cols);
+	col_basis_t.resize(col_basis.size());
+	for (size_t i = 0; i < col_basis.size(); i++) {
+	    col_basis[i] = MyDCTSample<T>::coeff(c->table[i]);
+	    col_basis_t[i] = MyDCTSample<T>::coeff(c->transposed[i]);
+	}
+	step.resize(static_cast<size_t>(m_rows) * m_cols);
+	acc.resize(m_cols);
+	rows = m_rows;
+	cols = m_cols;
+    }
+};
+
+/**
+ * One pass on the rows: out[r][k] = sum over x of in[r][x] * basis[x][k].
+ * @param basis A cols x cols table, [x][k].
+ */
+template <typename T>
+inline void MyTypedDCTRowPass(const T* in, ptrdiff_t in_stride, T* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+			      const typename MyDCTSample<T>::Coeff* basis, typename MyDCTSample<T>::Acc* MYDCT_RESTRICT acc) {
+    typedef typename MyDCTSample<T>::Acc Acc;
+    for (unsigned r = 0; r < rows; r++) {
+	const T* row = in + r * in_stride;
+	std::fill(acc, acc + cols, Acc(0));
+	for (unsigned x = 0; x < cols; x++) {
+	    Acc v = row[x];
+	    const typename MyDCTSample<T>::Coeff* MYDCT_RESTRICT b = basis + static_cast<size_t>(x) * cols;
+	    for (unsigned k = 0; k < cols; k++) acc[k] += v * b[k];
+	}
+	T* MYDCT_RESTRICT dst = out + r * out_stride;
+	for (unsigned k = 0; k < cols; k++) dst[k] = MyDCTSample<T>::narrow(acc[k]);
+    }
+}
+
+/**
+ * One pass on the columns: out[u][c] = sum over y of basis[u][y] * in[y][c] (or basis[y][u] if transposed).
+ * @param basis A rows x rows table, [u][y].
+ */
+template <typename T>
+inline void MyTypedDCTColPass(const T* in, ptrdiff_t in_stride, T* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+			      const typename MyDCTSample<T>::Coeff* basis, bool transposed,
+			      typename MyDCTSample<T>::Acc* MYDCT_RESTRICT acc) {
+    typedef typename MyDCTSample<T>::Acc Acc;
+    for (unsigned u = 0; u < rows; u++) {
+	std::fill(acc, acc + cols, Acc(0));
+	for (unsigned y = 0; y < rows; y++) {
+	    Acc b = transposed ? basis[static_cast<size_t>(y) * rows + u] : basis[static_cast<size_t>(u) * rows + y];
+	    const T* MYDCT_RESTRICT src = in + y * in_stride;
+	    for (unsigned c = 0; c < cols; c++) acc[c] += b * src[c];
+	}
+	T* MYDCT_RESTRICT dst = out + u * out_stride;
+	for (unsigned c = 0; c < cols; c++) dst[c] = MyDCTSample<T>::narrow(acc[c]);
+    }
+}
+
+/**
+ * Computes the 2-D DCT-II of a rows x cols matrix of samples of type T.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input).
+ * @param ws The workspace.
+ */
+template <typename T>
+inline void MyTypedDDCT2(const T* in, ptrdiff_t in_stride, T* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+			 MyTypedDCTWorkspace<T>& ws) {
+    ws.prepare(rows, cols);
+    MyTypedDCTRowPass(in, in_stride, &ws.step.front(), cols, rows, cols, &ws.col_basis_t.front(), &ws.acc.front());
+    MyTypedDCTColPass(&ws.step.front(), cols, out, out_stride, rows, cols, &ws.row_basis.front(), false, &ws.acc.front());
+}
+
+/**
+ * Computes the 2-D DCT-III (inverse DCT-II) of a rows x cols matrix of samples of type T.
+ * @param in The input matrix, whose rows are in_stride elements apart.
+ * @param out The output matrix, whose rows are out_stride elements apart (may alias the input).
+ * @param ws The workspace.
+ */
+template <typename T>
+inline void MyTypedDIDCT2(const T* in, ptrdiff_t in_stride, T* out, ptrdiff_t out_stride, unsigned rows, unsigned cols,
+			  MyTypedDCTWorkspace<T>& ws) {
+    ws.prepare(rows, cols);
+    MyTypedDCTRowPass(in, in_stride, &ws.step.front(), cols, rows, cols, &ws.col_basis.front(), &ws.acc.front());
+    MyTypedDCTColPass(&ws.step.front(), cols, out, out_stride, rows, cols, &ws.row_basis.front(), true, &ws.acc.front());
+}
+
+/**
+ * Converts a matrix of doubles to the sample type.
+ */
+template <typename T>
+inline void MyTypedFromDouble(const std::vector<double>& in, std::vector<T>& out, int frac_bits) {
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); i++) out[i] = MyDCTSample<T>::fromDouble(in[i], frac_bits);
+}
+
+/**
+ * Converts a matrix of samples back to doubles.
+ */
+template <typename T>
+inline void MyTypedToDouble(const std::vector<T>& in, std::vector<double>& out, int frac_bits) {
+    out.resize(in.size());
+    for (size_t i = 0; i < in.size(); i++) out[i] = MyDCTSample<T>::toDouble(in[i], frac_bits);
+}
+
+#endif  // PROJ2_MY_DCT_TYPED_H
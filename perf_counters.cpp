@@ -0,0 +1,186 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+/**
+ * Opens a disabled counter for a thread.
+ * @param counter The counter (PERF_COUNTER_*).
+ * @param tid The thread, 0 for the calling one.
+ * @return The file descriptor, or -1 (with errno set).
+ */
+static int perfOpen(int counter, pid_t tid) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+	case PERF_COUNTER_CYCLES:
+	    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	    break;
+	case PERF_COUNTER_INSTRUCTIONS:
+	    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	    break;
+	case PERF_COUNTER_L1D_MISSES:
+	    attr.type = PERF_TYPE_HW_CACHE;
+	    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	    break;
+	case PERF_COUNTER_LLC_MISSES:
+	    attr.config = PERF_COUNT_HW_CACHE_MISSES;  // Which the kernel maps to the last level cache
+	    break;
+	default:  // PERF_COUNTER_BRANCH_MISSES
+	    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+}
+
+/**
+ * @return The threads of the calling process.
+ */
+static std::vector<pid_t> perfProcessThreads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (dir == nullptr) return tids;
+    while (dirent* entry = readdir(dir)) {
+	if (entry->d_name[0] != '.') tids.push_back(static_cast<pid_t>(atoi(entry->d_name)));
+    }
+    closedir(dir);
+    return tids;
+}
+#endif
+
+/**
+ * Opens the counters, disabled.
+ * @param scope PERF_SCOPE_THREAD or PERF_SCOPE_PROCESS.
+ */
+PerfCounters::PerfCounters(int scope) {
+#ifdef __linux__
+    std::vector<pid_t> tids(1, 0);
+    if (scope == PERF_SCOPE_PROCESS) tids = perfProcessThreads();
+    int last_errno = 0;
+    bool any = false;
+    for (pid_t tid : tids) {
+	for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++) {
+	    int fd = perfOpen(counter, tid);
+	    if (fd < 0) {
+		last_errno = errno;
+	    } else {
+		any = true;
+	    }
+	    fds.push_back(fd);
+	}
+    }
+    if (!any) {
+	error = std::string("perf_event_open() failed: ") + strerror(last_errno != 0 ? last_errno : ENOENT);
+	if (last_errno == EACCES || last_errno == EPERM) error += " (see /proc/sys/kernel/perf_event_paranoid)";
+    }
+#else
+    (void)scope;
+    error = "Hardware counters are only supported on Linux.";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds)
+	if (fd >= 0) close(fd);
+#endif
+}
+
+void PerfCounters::ioctlAll(unsigned long request) {
+#ifdef __linux__
+    for (int fd : fds)
+	if (fd >= 0) ioctl(fd, request, 0);
+#else
+    (void)request;
+#endif
+}
+
+/**
+ * Zeroes the counters and starts counting.
+ */
+void PerfCounters::start() {
+#ifdef __linux__
+    ioctlAll(PERF_EVENT_IOC_RESET);
+    ioctlAll(PERF_EVENT_IOC_ENABLE);
+#endif
+}
+
+/**
+ * Stops counting.
+ * @return The counts since start(), summed over the threads.
+ */
+PerfCounts PerfCounters::stop() {
+    PerfCounts counts;
+#ifdef __linux__
+    ioctlAll(PERF_EVENT_IOC_DISABLE);
+    for (size_t i = 0; i < fds.size(); i++) {
+	uint64_t data[3];  // Value, time enabled, time running
+	if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) continue;
+	int counter = static_cast<int>(i % PERF_COUNTER_COUNT);
+	double value = static_cast<double>(data[0]);
+	if (data[2] > 0 && data[2] < data[1]) value *= static_cast<double>(data[1]) / static_cast<double>(data[2]);
+	counts.values[counter] += value;
+	counts.valid[counter] = true;
+    }
+#endif
+    return counts;
+}
+
+/**
+ * @return The name of a counter (PERF_COUNTER_*).
+ */
+const char* perfCounterName(int counter) {
+    static const char* names[] = {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+    return counter >= 0 && counter < PERF_COUNTER_COUNT ? names[counter] : "?";
+}
+
+/**
+ * The number of floating point operations a table-driven 2-D DCT of a matrix performs (a multiplication and an addition per
+ * term of each pass), which is what the GFLOP/s of every implementation are computed from: the fast ones, which do less
+ * work, get a rate that can exceed what the CPU can actually do.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ */
+double perfNominalDctFlops(int rows, int cols) {
+    return 2.0 * rows * cols * (static_cast<double>(rows) + cols);
+}
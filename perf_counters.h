@@ -0,0 +1,99 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_PERF_COUNTERS_H
+#define PROJ2_PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_INSTRUCTIONS 1
+#define PERF_COUNTER_L1D_MISSES 2  // L1 data cache read misses
+#define PERF_COUNTER_LLC_MISSES 3  // Last level cache misses
+#define PERF_COUNTER_BRANCH_MISSES 4
+#define PERF_COUNTER_COUNT 5
+
+#define PERF_SCOPE_THREAD 0   // The calling thread only
+#define PERF_SCOPE_PROCESS 1  // Every thread of the process that exists when the counters are opened
+
+/**
+ * The values read from the hardware counters. A counter that couldn't be opened is not valid, and its value is 0.
+ */
+struct PerfCounts {
+    double values[PERF_COUNTER_COUNT] = {};
+    bool valid[PERF_COUNTER_COUNT] = {};
+
+    bool isValid(int counter) const { return valid[counter]; }
+    bool anyValid() const {
+	for (bool v : valid)
+	    if (v) return true;
+	return false;
+    }
+    /**
+     * @return The instructions per cycle, or 0 if either counter is missing.
+     */
+    double getIpc() const {
+	if (!valid[PERF_COUNTER_CYCLES] || !valid[PERF_COUNTER_INSTRUCTIONS] || values[PERF_COUNTER_CYCLES] <= 0) return 0;
+	return values[PERF_COUNTER_INSTRUCTIONS] / values[PERF_COUNTER_CYCLES];
+    }
+    /**
+     * @return The same counts divided by the given number (of calls, of pixels...).
+     */
+    PerfCounts per(double n) const {
+	PerfCounts result = *this;
+	for (double& v : result.values) v /= n;
+	return result;
+    }
+};
+
+/**
+ * A set of hardware counters (see PERF_COUNTER_*), read through the Linux perf_event_open() interface. Only user space
+ * events are counted, which is what an unprivileged process is allowed to do with the default perf_event_paranoid setting.
+ * Each counter is opened on its own, so the ones the CPU or the kernel don't provide (as in most virtual machines) are
+ * simply reported as missing; if none of them can be opened, isAvailable() returns false and getError() tells why, and
+ * start() and stop() do nothing. Counters that the kernel has to multiplex are scaled to the whole measured time.
+ */
+class PerfCounters {
+   private:
+    std::vector<int> fds;  // PERF_COUNTER_COUNT for each thread, -1 where unavailable
+    std::string error;
+
+    void ioctlAll(unsigned long request);
+
+   public:
+    explicit PerfCounters(int scope = PERF_SCOPE_THREAD);
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool isAvailable() const { return error.empty(); }
+    const std::string& getError() const { return error; }
+    void start();
+    PerfCounts stop();
+};
+
+const char* perfCounterName(int);
+double perfNominalDctFlops(int, int);
+
+#endif  // PROJ2_PERF_COUNTERS_H
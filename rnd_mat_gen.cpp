@@ -23,25 +23,181 @@
 
 #include "rnd_mat_gen.h"
 
+#include <cmath>
 #include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
 #include <string>
 
 #include "csv_import_export.h"
 #include "dct_bench.h"
 #include "imgui.h"
+#include "mat_file.h"
+#include "thread_pool.h"
+
+/*
+ * The generator is counter-based: element i of a matrix is a hash of the seed and i (the output function of SplitMix64,
+ * applied to the seed plus i times its increment, which is the i-th number SplitMix64 would produce), so any range of the
+ * matrix can be filled independently of the others. The matrices are thus filled in parallel, in bands of rows, and are
+ * the same for a given seed whatever the number of threads.
+ */
+
+#define RND_GAMMA 0x9E3779B97F4A7C15ULL
+
+/**
+ * @return The i-th number of the sequence of a seed.
+ */
+static inline uint64_t rndAt(uint64_t seed, uint64_t i) {
+    uint64_t z = seed + (i + 1) * RND_GAMMA;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @return A uniform number in [0, 1), out of the top 53 bits of a hash.
+ */
+static inline double rndUnit(uint64_t bits) {
+    return static_cast<double>(bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Value noise: a grid of random values, one every cell pixels, interpolated with a smoothstep.
+ * @param seed The seed of the grid.
+ * @param row The row of the pixel.
+ * @param col The column of the pixel.
+ * @param cell The spacing of the grid.
+ * @return A number in [0, 1).
+ */
+static double rndValueNoise(uint64_t seed, unsigned row, unsigned col, unsigned cell) {
+    unsigned gy = row / cell, gx = col / cell;
+    double fy = static_cast<double>(row % cell) / cell, fx = static_cast<double>(col % cell) / cell;
+    fy = fy * fy * (3 - 2 * fy);
+    fx = fx * fx * (3 - 2 * fx);
+    auto node = [seed](unsigned y, unsigned x) { return rndUnit(rndAt(seed, (static_cast<uint64_t>(y) << 32) | x)); };
+    double top = node(gy, gx) + (node(gy, gx + 1) - node(gy, gx)) * fx;
+    double bottom = node(gy + 1, gx) + (node(gy + 1, gx + 1) - node(gy + 1, gx)) * fx;
+    return top + (bottom - top) * fy;
+}
+
+/**
+ * Fills a band of rows of a matrix (see genRndMatInto()).
+ */
+static void rndFillRows(double* out, unsigned first, unsigned last, unsigned cols, uint64_t seed, int dist) {
+    const uint64_t octave_seeds[] = {rndAt(seed, ~0ULL), rndAt(seed, ~1ULL), rndAt(seed, ~2ULL)};
+    for (unsigned row = first; row < last; row++) {
+	double* dst = out + static_cast<size_t>(row) * cols;
+	uint64_t base = static_cast<uint64_t>(row) * cols;
+	switch (dist) {
+	    case RND_DIST_GAUSSIAN:
+		for (unsigned col = 0; col < cols; col++) {  // Box-Muller, out of two numbers of the sequence per element
+		    double u1 = 1.0 - rndUnit(rndAt(seed, 2 * (base + col)));  // In (0, 1]
+		    double u2 = rndUnit(rndAt(seed, 2 * (base + col) + 1));
+		    dst[col] = RND_GAUSSIAN_SIGMA * std::sqrt(-2.0 * std::log(u1)) * std::cos(2 * M_PI * u2);
+		}
+		break;
+	    case RND_DIST_SMOOTH:
+		// Three octaves, each with half the amplitude of the previous one and a grid of its own (246 at most)
+		for (unsigned col = 0; col < cols; col++) {
+		    double value = 136 * rndValueNoise(octave_seeds[0], row, col, 64) +
+				   68 * rndValueNoise(octave_seeds[1], row, col, 16) +
+				   34 * rndValueNoise(octave_seeds[2], row, col, 4) + 8 * rndUnit(rndAt(seed, base + col));
+		    dst[col] = std::floor(value);
+		}
+		break;
+	    default:  // RND_DIST_UNIFORM
+		for (unsigned col = 0; col < cols; col++) dst[col] = -999.0 + 1999.0 * rndUnit(rndAt(seed, base + col));
+	}
+    }
+}
+
+/**
+ * @return A new seed, from std::random_device.
+ */
+uint64_t rndNewSeed() {
+    static std::random_device rd;
+    static std::mutex mtx;  // The benchmarks call this from their background jobs
+    std::lock_guard<std::mutex> lock(mtx);
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+/**
+ * @return The name of a distribution (RND_DIST_*).
+ */
+const char* rndDistName(int dist) {
+    static const char* names[] = {"Uniform", "Gaussian", "Smooth field"};
+    return dist >= RND_DIST_UNIFORM && dist <= RND_DIST_SMOOTH ? names[dist] : "?";
+}
+
+/**
+ * Fills a matrix with random numbers, on the shared thread pool if it's large. The result only depends on the seed, the
+ * distribution and the size of the matrix.
+ * @param out Room for rows*cols elements.
+ * @param rows The number of rows of the matrix.
+ * @param cols The number of columns of the matrix.
+ * @param seed The seed.
+ * @param dist The distribution (RND_DIST_*). The smooth field is made of features a few pixels to 64 pixels wide, so it
+ * should be at least that large to look like an image.
+ * @throws std::invalid_argument If the distribution is unknown.
+ */
+void genRndMatInto(double* out, unsigned rows, unsigned cols, uint64_t seed, int dist) {
+    if (dist < RND_DIST_UNIFORM || dist > RND_DIST_SMOOTH) throw std::invalid_argument("Unknown distribution.");
+    if (static_cast<size_t>(rows) * cols < RND_PARALLEL_MIN_ELEMS) {
+	rndFillRows(out, 0, rows, cols, seed, dist);
+	return;
+    }
+    getSharedThreadPool().parallelFor(0, rows, [&](size_t first, size_t last) {
+	rndFillRows(out, static_cast<unsigned>(first), static_cast<unsigned>(last), cols, seed, dist);
+    });
+}
+
+/**
+ * Generates a random matrix (see genRndMatInto()).
+ * @param mat_width The number of columns of the matrix.
+ * @param mat_height The number of rows of the matrix.
+ * @param seed The seed.
+ * @param dist The distribution (RND_DIST_*).
+ * @return The elements, row by row.
+ */
+std::vector<double> genRndMat(unsigned mat_width, unsigned mat_height, uint64_t seed, int dist) {
+    std::vector<double> mat(static_cast<size_t>(mat_width) * mat_height);
+    if (!mat.empty()) genRndMatInto(&mat.front(), mat_height, mat_width, seed, dist);
+    return mat;
+}
+
+/**
+ * Generates a matrix of uniform random numbers in [-999, 1000), with a new seed every time.
+ * @param mat_width The number of columns of the matrix.
+ * @param mat_height The number of rows of the matrix.
+ * @return The elements, row by row.
+ */
+std::vector<double> genRndMat(unsigned mat_width, unsigned mat_height) {
+    return genRndMat(mat_width, mat_height, rndNewSeed());
+}
 
 void rndMatGenWindow(bool* visible) {
     static int mat_width = 8;
+    static int seed = (int)(rndNewSeed() & 0x7fffffff);
+    static int dist = RND_DIST_UNIFORM;
     static bool mat_ready = false;
     static char csv_file_path[128] = "./out.csv";
     static char io_status_msg[512] = "No file specified.";
     static std::vector<double> mat;
-    ImGui::SetNextWindowSize(ImVec2(600, 270), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(600, 320), ImGuiCond_Once);
     ImGui::Begin(RND_MAT_GEN_WINDOW_TITLE, visible);
     ImGui::SliderInt("Matrix Width", &mat_width, 8, 256);
+    ImGui::InputInt("Seed", &seed);
+    ImGui::SameLine();
+    if (ImGui::Button("New Seed")) seed = (int)(rndNewSeed() & 0x7fffffff);
+    ImGui::RadioButton(rndDistName(RND_DIST_UNIFORM), &dist, RND_DIST_UNIFORM);
+    ImGui::SameLine();
+    ImGui::RadioButton(rndDistName(RND_DIST_GAUSSIAN), &dist, RND_DIST_GAUSSIAN);
+    ImGui::SameLine();
+    ImGui::RadioButton(rndDistName(RND_DIST_SMOOTH), &dist, RND_DIST_SMOOTH);
     if (ImGui::Button("Generate New Matrix")) {
 	mat_ready = false;
-	mat = genRndMat(mat_width, mat_width);
+	mat = genRndMat(mat_width, mat_width, (uint32_t)seed, dist);
 	mat_ready = true;
     }
     if (mat_ready) {
@@ -58,11 +214,15 @@ void rndMatGenWindow(bool* visible) {
     if (ImGui::Button("Save to CSV File")) {
 	if (mat_ready) {
 	    try {
-		csvExportMatrix(csv_file_path, mat, mat_width, mat_width);
+		if (matFileIsBinary(csv_file_path)) {
+		    matFileExport(csv_file_path, mat, mat_width, mat_width);
+		} else {
+		    csvExportMatrix(csv_file_path, mat, mat_width, mat_width);
+		}
+		snprintf((char*)&io_status_msg, 512, "File written successfully!");
 	    } catch (std::runtime_error& e) {
 		snprintf((char*)&io_status_msg, 512, "%s", e.what());
 	    }
-	    snprintf((char*)&io_status_msg, 512, "File written successfully!");
 	} else {
 	    snprintf((char*)&io_status_msg, 512, "No data to write.");
 	}
@@ -26,21 +26,21 @@
 
 #define RND_MAT_GEN_WINDOW_TITLE "Random Matrix Generator"
 
-#include <random>
+#include <cstdint>
 #include <vector>
 
-inline std::vector<double> genRndMat(unsigned mat_width, unsigned mat_height) {
-    static std::random_device rd;
-    static std::mt19937 mt(rd());
-    static std::uniform_real_distribution<double> dist(-999.0, +1000.0);
-    std::vector<double> mat;
-    unsigned cur = mat_width * mat_height;
-    while (cur > 0) {
-	mat.push_back(dist(mt));
-	cur--;
-    }
-    return mat;
-}
+#define RND_DIST_UNIFORM 0   // Uniform in [-999, 1000), what genRndMat() has always produced
+#define RND_DIST_GAUSSIAN 1  // Normal, with mean 0 and standard deviation RND_GAUSSIAN_SIGMA
+#define RND_DIST_SMOOTH 2    // Image-like: smooth value noise in [0, 255], plus a little grain
+
+#define RND_GAUSSIAN_SIGMA 333.0
+#define RND_PARALLEL_MIN_ELEMS (1 << 16)  // Smaller matrices are generated on the calling thread
+
+uint64_t rndNewSeed();
+const char* rndDistName(int);
+void genRndMatInto(double*, unsigned, unsigned, uint64_t, int = RND_DIST_UNIFORM);
+std::vector<double> genRndMat(unsigned, unsigned, uint64_t, int = RND_DIST_UNIFORM);
+std::vector<double> genRndMat(unsigned, unsigned);
 
 void rndMatGenWindow(bool*);
 
@@ -0,0 +1,185 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+struct ThreadPool::Job {
+    const std::function<void(size_t, size_t)>* body;
+    std::atomic<size_t> pending;
+    std::mutex error_mtx;
+    std::exception_ptr error;
+};
+
+static thread_local const ThreadPool* current_pool = nullptr;  // The pool the current thread is working for, if any
+
+/**
+ * Spawns the workers.
+ * @param threads The number of threads that will take part in a parallelFor(), including the calling one (0 means one per
+ * hardware thread).
+ */
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = getDefaultThreadCount();
+    this->threads = std::min(threads, THREAD_POOL_MAX_THREADS);
+    for (unsigned i = 0; i < this->threads; i++) queues.emplace_back(new Queue());
+    for (unsigned i = 1; i < this->threads; i++) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+	std::lock_guard<std::mutex> lock(mtx);
+	stop = true;
+    }
+    wake_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+/**
+ * @return The number of hardware threads, or 1 if it can't be determined.
+ */
+unsigned ThreadPool::getDefaultThreadCount() {
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : hw;
+}
+
+/**
+ * Runs a single chunk, taken from the participant's own queue or stolen from another one.
+ * @param id The participant.
+ * @return false if every queue was empty.
+ */
+bool ThreadPool::runOne(unsigned id) {
+    Task task{};
+    bool found = false;
+    for (unsigned i = 0; i < threads && !found; i++) {
+	Queue& queue = *queues[(id + i) % threads];
+	std::lock_guard<std::mutex> lock(queue.mtx);
+	if (queue.tasks.empty()) continue;
+	if (i == 0) {  // Own queue, in order
+	    task = queue.tasks.front();
+	    queue.tasks.pop_front();
+	} else {  // Steal from the far end
+	    task = queue.tasks.back();
+	    queue.tasks.pop_back();
+	}
+	found = true;
+    }
+    if (!found) return false;
+    Job* job = task.job;
+    try {
+	(*job->body)(task.begin, task.end);
+    } catch (...) {
+	std::lock_guard<std::mutex> lock(job->error_mtx);
+	if (!job->error) job->error = std::current_exception();
+    }
+    if (job->pending.fetch_sub(1) == 1) {  // The job must not be touched past this point
+	std::lock_guard<std::mutex> lock(done_mtx);
+	done_cv.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned id) {
+    current_pool = this;
+    unsigned long seen = 0;
+    for (;;) {
+	{
+	    std::unique_lock<std::mutex> lock(mtx);
+	    wake_cv.wait(lock, [&] { return stop || generation != seen; });
+	    if (stop) return;
+	    seen = generation;
+	}
+	while (runOne(id)) {
+	}
+    }
+}
+
+/**
+ * Calls body on consecutive, non-overlapping sub-ranges covering [begin, end), spread across the pool, and waits for all of
+ * them to complete. The calling thread takes part in the work. If any call throws, the first exception is rethrown here once
+ * every sub-range has been processed.
+ * @param begin The start of the range.
+ * @param end The end of the range (excluded).
+ * @param body The function to call on every sub-range, as body(sub_begin, sub_end).
+ * @param grain The size of the sub-ranges (0 splits the range in THREAD_POOL_CHUNKS_PER_THREAD chunks per thread).
+ */
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& body, size_t grain) {
+    if (end <= begin) return;
+    size_t range = end - begin;
+    if (grain == 0) grain = std::max<size_t>(1, (range + threads * THREAD_POOL_CHUNKS_PER_THREAD - 1) /
+						    (threads * THREAD_POOL_CHUNKS_PER_THREAD));
+    if (threads == 1 || range <= grain || current_pool == this) {
+	body(begin, end);
+	return;
+    }
+    std::lock_guard<std::mutex> call_lock(call_mtx);
+    size_t chunks = (range + grain - 1) / grain;
+    Job job;
+    job.body = &body;
+    job.pending = chunks;
+    // Every participant gets a contiguous stretch of chunks, so that it walks memory in order until it has to steal
+    for (size_t c = 0; c < chunks; c++) {
+	Queue& queue = *queues[c * threads / chunks];
+	std::lock_guard<std::mutex> lock(queue.mtx);
+	queue.tasks.push_back({&job, begin + c * grain, std::min(end, begin + (c + 1) * grain)});
+    }
+    {
+	std::lock_guard<std::mutex> lock(mtx);
+	generation++;
+    }
+    wake_cv.notify_all();
+    const ThreadPool* outer_pool = current_pool;
+    current_pool = this;
+    while (runOne(0)) {
+    }
+    current_pool = outer_pool;
+    {
+	std::unique_lock<std::mutex> lock(done_mtx);
+	done_cv.wait(lock, [&] { return job.pending == 0; });
+    }
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+static std::mutex shared_pool_mtx;
+static std::unique_ptr<ThreadPool> shared_pool;
+
+/**
+ * @return The pool used by the parallel transforms when none is given, created on first use with one thread per hardware
+ * thread.
+ */
+ThreadPool& getSharedThreadPool() {
+    std::lock_guard<std::mutex> lock(shared_pool_mtx);
+    if (!shared_pool) shared_pool.reset(new ThreadPool());
+    return *shared_pool;
+}
+
+/**
+ * Replaces the shared pool with one of the given size. Must not be called while the shared pool is in use.
+ * @param threads The new number of threads (0 means one per hardware thread).
+ */
+void setSharedThreadCount(unsigned threads) {
+    std::lock_guard<std::mutex> lock(shared_pool_mtx);
+    if (threads == 0) threads = ThreadPool::getDefaultThreadCount();
+    if (shared_pool && shared_pool->getThreadCount() == std::min(threads, THREAD_POOL_MAX_THREADS)) return;
+    shared_pool.reset(new ThreadPool(threads));
+}
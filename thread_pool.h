@@ -0,0 +1,88 @@
+/*
+    Bitmap image compressor using OpenCV's DCT implementation and (optionally)
+    an homegrown algorithm. Provides an A-B comparison functionality and a GUI.
+
+    Copyright (C) 2022  Jacopo Maltagliati
+    Copyright (C) 2022  Alessandro Albi
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#ifndef PROJ2_THREAD_POOL_H
+#define PROJ2_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define THREAD_POOL_MAX_THREADS 256u
+#define THREAD_POOL_CHUNKS_PER_THREAD 4u  // How finely a range is split when no grain is given
+
+/**
+ * A fixed-size pool of worker threads, reused across calls to parallelFor(). Each participant (the workers and the calling
+ * thread) owns a queue of chunks of the range: it consumes its own queue from the front and, once it's empty, steals from
+ * the back of the others', so a participant that gets slowed down doesn't hold up the whole call.
+ * Only one parallelFor() runs at a time on a given pool; a parallelFor() issued from inside a body runs serially.
+ */
+class ThreadPool {
+   private:
+    struct Job;
+    struct Task {
+	Job* job;
+	size_t begin, end;
+    };
+    struct Queue {
+	std::mutex mtx;
+	std::deque<Task> tasks;
+    };
+
+    unsigned threads;
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;  // One per participant, the calling thread is number 0
+    std::mutex mtx;                              // Guards generation and stop
+    std::condition_variable wake_cv;
+    unsigned long generation = 0;
+    bool stop = false;
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    std::mutex call_mtx;  // Serializes parallelFor()
+
+    void workerLoop(unsigned id);
+    bool runOne(unsigned id);
+
+   public:
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned getThreadCount() const { return threads; }
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& body, size_t grain = 0);
+
+    static unsigned getDefaultThreadCount();
+};
+
+ThreadPool& getSharedThreadPool();
+void setSharedThreadCount(unsigned threads);
+
+#endif  // PROJ2_THREAD_POOL_H